@@ -348,30 +348,50 @@ AppPlci_debug(struct FsmInst *fi, char *fmt, ...)
 	va_end(args);
 }
 
-static inline void
-Send2Application(AppPlci_t *aplci, _cmsg *cmsg)
-{
-	SendCmsg2Application(aplci->appl, cmsg);
-}
-
+/*
+ * deliver the delayedq, the caller must have set APPLCI_STATE_SENDDELAYED
+ * all queued messages are taken at once, messages queued meanwhile are
+ * delivered in the next round
+ */
 static void
 SendingDelayedMsg(AppPlci_t *aplci)
 {
-	struct sk_buff  *skb;
-
-	while((skb = skb_dequeue(&aplci->delayedq))) {
-		if (test_bit(APPL_STATE_RELEASE, &aplci->appl->state)) {
-			printk(KERN_WARNING "%s: Application allready released\n", __FUNCTION__);
-			dev_kfree_skb(skb);
-		} else {
+	struct sk_buff_head	batch;
+	struct sk_buff		*skb;
+	u_long			flags, hold;
+	int			released;
+
+	skb_queue_head_init(&batch);
+	do {
+		spin_lock_irqsave(&aplci->delayedq.lock, flags);
+		while ((skb = __skb_dequeue(&aplci->delayedq)))
+			__skb_queue_tail(&batch, skb);
+		spin_unlock_irqrestore(&aplci->delayedq.lock, flags);
+		if (skb_queue_len(&batch)) {
+			aplci->dstat.batches++;
+			released = test_bit(APPL_STATE_RELEASE, &aplci->appl->state);
+			if (released)
+				printk(KERN_WARNING "%s: Application allready released\n", __FUNCTION__);
+			while ((skb = __skb_dequeue(&batch))) {
+				hold = jiffies - CAPI_SKB_QTIME(skb);
+				aplci->dstat.hold_sum += hold;
+				if (hold > aplci->dstat.hold_max)
+					aplci->dstat.hold_max = hold;
+				if (released) {
+					dev_kfree_skb(skb);
+					continue;
+				}
 #ifdef OLDCAPI_DRIVER_INTERFACE
-			aplci->appl->contr->ctrl->handle_capimsg(aplci->appl->contr->ctrl, aplci->appl->ApplId, skb);
+				aplci->appl->contr->ctrl->handle_capimsg(aplci->appl->contr->ctrl, aplci->appl->ApplId, skb);
 #else
-			capi_ctr_handle_message(aplci->appl->contr->ctrl, aplci->appl->ApplId, skb);
+				capi_ctr_handle_message(aplci->appl->contr->ctrl, aplci->appl->ApplId, skb);
 #endif
+			}
 		}
-	}
-	test_and_clear_bit(PLCI_STATE_SENDDELAYED, &aplci->plci->state);
+		test_and_clear_bit(APPLCI_STATE_SENDDELAYED, &aplci->state);
+		/* a message queued after the last round would be stuck */
+	} while (skb_queue_len(&aplci->delayedq) &&
+		!test_and_set_bit(APPLCI_STATE_SENDDELAYED, &aplci->state));
 }
 
 static void
@@ -390,7 +410,8 @@ Send2ApplicationDelayed(AppPlci_t *aplci, _cmsg *cmsg)
 		cmsg_free(cmsg);
 		return;
 	}
-	capi_cmsg2message(cmsg, skb->data);
+	if (!capi_fast_cmsg2message(cmsg, skb->data))
+		capi_cmsg2message(cmsg, skb->data);
 	AppPlciDebug(aplci, CAPI_DBG_APPL_MSG, "%s: len(%d) applid(%x) %s msgnr(%d) addr(%08x)",
 		__FUNCTION__, CAPIMSG_LEN(skb->data), cmsg->ApplId, capi_cmd2str(cmsg->Command, cmsg->Subcommand),
 		cmsg->Messagenumber, cmsg->adr.adrController);
@@ -403,12 +424,32 @@ Send2ApplicationDelayed(AppPlci_t *aplci, _cmsg *cmsg)
 		return;
 	}
 	skb_put(skb, CAPIMSG_LEN(skb->data));
+	CAPI_SKB_QTIME(skb) = jiffies;
 	skb_queue_tail(&aplci->delayedq, skb);
+	aplci->dstat.msgs++;
+	if (skb_queue_len(&aplci->delayedq) > aplci->dstat.depth_max)
+		aplci->dstat.depth_max = skb_queue_len(&aplci->delayedq);
 	if (test_bit(PLCI_STATE_STACKREADY, &aplci->plci->state) &&
-		!test_and_set_bit(PLCI_STATE_SENDDELAYED, &aplci->plci->state))
+		!test_and_set_bit(APPLCI_STATE_SENDDELAYED, &aplci->state))
 		SendingDelayedMsg(aplci);
 }
 
+/*
+ * Messages must not overtake held messages, so while held messages
+ * are delivered, new messages are queued behind them. If the stack is
+ * not ready, the held messages wait for it, the others are sent at once.
+ */
+static inline void
+Send2Application(AppPlci_t *aplci, _cmsg *cmsg)
+{
+	if (test_bit(APPLCI_STATE_SENDDELAYED, &aplci->state) ||
+		(skb_queue_len(&aplci->delayedq) &&
+		test_bit(PLCI_STATE_STACKREADY, &aplci->plci->state)))
+		Send2ApplicationDelayed(aplci, cmsg);
+	else
+		SendCmsg2Application(aplci->appl, cmsg);
+}
+
 static inline void
 AppPlciCmsgHeader(AppPlci_t *aplci, _cmsg *cmsg, __u8 cmd, __u8 subcmd)
 {
@@ -1432,8 +1473,22 @@ void AppPlciDestr(AppPlci_t *aplci)
 	list_for_each_safe(item, next, &aplci->Nccis) {
 		ncciDelAppPlci((Ncci_t *)item);
 	}
-	if (aplci->appl)
+	if (aplci->dstat.msgs)
+		AppPlciDebug(aplci, CAPI_DBG_PLCI, "%s: PLCI(%x) delayed msgs %lu batches %lu depth %lu hold %lu/%lu jiffies",
+			__FUNCTION__, aplci->addr, aplci->dstat.msgs, aplci->dstat.batches,
+			aplci->dstat.depth_max, aplci->dstat.hold_sum, aplci->dstat.hold_max);
+	if (aplci->appl) {
+		DelayStat_t	*ds = &aplci->appl->dstat;
+
+		ds->msgs += aplci->dstat.msgs;
+		ds->batches += aplci->dstat.batches;
+		ds->hold_sum += aplci->dstat.hold_sum;
+		if (aplci->dstat.depth_max > ds->depth_max)
+			ds->depth_max = aplci->dstat.depth_max;
+		if (aplci->dstat.hold_max > ds->hold_max)
+			ds->hold_max = aplci->dstat.hold_max;
 		ApplicationDelAppPlci(aplci->appl, aplci);
+	}
 	skb_queue_purge(&aplci->delayedq);
 	AppPlci_free(aplci);
 }
@@ -1517,7 +1572,16 @@ PL_l3l4mux(mISDNinstance_t *inst, struct sk_buff *skb)
 		return(-EINVAL);
 	}
 	if (hh->prim == CAPI_MESSAGE_REQUEST) {
-		ncci = getNCCI4addr(aplci, CAPIMSG_NCCI(skb->data), GET_NCCI_EXACT);
+		/* only FACILITY and MANUFACTURER requests may use the PLCI address */
+		switch (CAPIMSG_COMMAND(skb->data)) {
+			case CAPI_FACILITY:
+			case CAPI_MANUFACTURER:
+				ncci = getNCCI4addr(aplci, CAPIMSG_NCCI(skb->data), GET_NCCI_PLCI);
+				break;
+			default:
+				ncci = getNCCI4addr(aplci, CAPIMSG_NCCI(skb->data), GET_NCCI_EXACT);
+				break;
+		}
 		if (!ncci) {
 			int_error();
 			return(-EINVAL);
@@ -1737,11 +1801,9 @@ AppPlcimISDN_Active(AppPlci_t *aplci)
 		int_error();
 		return(-EINVAL);
 	}
-	if (!test_and_set_bit(PLCI_STATE_SENDDELAYED, &aplci->plci->state)) {
-		test_and_set_bit(PLCI_STATE_STACKREADY, &aplci->plci->state);
+	test_and_set_bit(PLCI_STATE_STACKREADY, &aplci->plci->state);
+	if (!test_and_set_bit(APPLCI_STATE_SENDDELAYED, &aplci->state))
 		SendingDelayedMsg(aplci);
-	} else
-		test_and_set_bit(PLCI_STATE_STACKREADY, &aplci->plci->state);
 	return(0);
 }
 
@@ -2060,16 +2122,9 @@ DisconnectB3Request(AppPlci_t *aplci, struct sk_buff *skb)
 		dev_kfree_skb(skb);
 		return;
 	}
-	if (ncci->link->inst.id == 0) {
-		/* stack is already cleared and so we cannot handle this via the stack */
-		ncciSendMessage(ncci, skb);
-		return;
-	}
-	err = mISDN_queue_message(&ncci->link->inst, 0, skb);
-	if (err) {
-		int_errtxt("mISDN_queue_message return(%d)", err);
+	err = ncciQueueMessage(ncci, skb);
+	if (err)
 		dev_kfree_skb(skb);
-	}
 }
 
 static int
@@ -2273,6 +2328,7 @@ void init_AppPlci(void)
 	plci_fsm.event_count = EV_PLCI_COUNT;
 	plci_fsm.strEvent = str_ev_plci;
 	plci_fsm.strState = str_st_plci;
+	plci_fsm.name = "plci";
 	
 	mISDN_FsmNew(&plci_fsm, fn_plci_list, FN_PLCI_COUNT);
 }
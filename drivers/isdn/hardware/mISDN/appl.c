@@ -18,6 +18,16 @@
 
 static struct list_head	garbage_applications = LIST_HEAD_INIT(garbage_applications);
 
+/* remove from the controller list and the ApplId table */
+static void
+applUnlink(Application_t *appl, Controller_t *contr)
+{
+	list_del_init(&appl->head);
+	if (contr && (appl->ApplId <= CAPI_MAXAPPL) &&
+		(contr->appltab[appl->ApplId] == appl))
+		contr->appltab[appl->ApplId] = NULL;
+}
+
 int
 ApplicationConstr(Controller_t *contr, __u16 ApplId, capi_register_params *rp)
 {
@@ -42,6 +52,8 @@ ApplicationConstr(Controller_t *contr, __u16 ApplId, capi_register_params *rp)
 	memcpy(&appl->reg_params, rp, sizeof(capi_register_params));
 	listenConstr(appl);
 	list_add(&appl->head, &contr->Applications);
+	if (ApplId <= CAPI_MAXAPPL)
+		contr->appltab[ApplId] = appl;
 	test_and_set_bit(APPL_STATE_ACTIV, &appl->state);
 	return(0);
 }
@@ -63,6 +75,7 @@ ApplicationDestr(Application_t *appl, int who)
 {
 	int		i, used = 0;
 	AppPlci_t	**aplci_p = appl->AppPlcis;
+	Controller_t	*contr = appl->contr;
 
 	if (test_and_set_bit(APPL_STATE_DESTRUCTOR, &appl->state)) {
 		// we are allready in this function
@@ -97,13 +110,17 @@ ApplicationDestr(Application_t *appl, int who)
 	}
 	if (used) {
 		if (who == 3) {
-			list_del_init(&appl->head);
+			applUnlink(appl, contr);
 			list_add(&appl->head, &garbage_applications);
 		}
 		test_and_clear_bit(APPL_STATE_DESTRUCTOR, &appl->state);
 		return(-EBUSY);
 	}
-	list_del_init(&appl->head);
+	applUnlink(appl, contr);
+	if (appl->dstat.msgs)
+		applDebug(appl, CAPI_DBG_APPL, "%s: ApplId(%x) delayed msgs %lu batches %lu depth %lu hold %lu/%lu jiffies",
+			__FUNCTION__, appl->ApplId, appl->dstat.msgs, appl->dstat.batches,
+			appl->dstat.depth_max, appl->dstat.hold_sum, appl->dstat.hold_max);
 	appl->maxplci = 0;
 	kfree(appl->AppPlcis);
 	appl->AppPlcis = NULL;
@@ -143,6 +160,11 @@ FacilityReq(Application_t *appl, struct sk_buff *skb)
 			aplci = getAppPlci4addr(appl, CAPIMSG_CONTROL(skb->data));
 			if (aplci) {
 				ncci = getNCCI4addr(aplci, CAPIMSG_NCCI(skb->data), GET_NCCI_PLCI);
+				if (ncci && test_bit(NCCI_STATE_L3TRANS, &ncci->state) &&
+					!ncciQueueMessage(ncci, skb)) {
+					cmsg_free(cmsg);
+					return;
+				}
 				if (ncci) {
 					ncciGetCmsg(ncci, cmsg);
 					break;
@@ -297,6 +319,62 @@ ApplicationDelAppPlci(Application_t *appl, AppPlci_t *aplci)
 		ApplicationDestr(appl, 0);
 }
 
+static __inline__ int
+put_cstruct(__u8 *m, _cstruct s)
+{
+	int	l;
+
+	if (!s) {
+		*m = 0;
+		return(1);
+	}
+	if (s[0] != 0xff)
+		l = 1 + s[0];
+	else
+		l = 3 + (s[1] | (s[2] << 8));
+	memcpy(m, s, l);
+	return(l);
+}
+
+/*
+ * encode the frequent simple messages directly, returns the message
+ * length or 0, if the message must be encoded with capi_cmsg2message()
+ */
+int
+capi_fast_cmsg2message(_cmsg *cmsg, __u8 *m)
+{
+	int	len;
+
+	switch (CAPICMD(cmsg->Command, cmsg->Subcommand)) {
+		case CAPI_DATA_B3_CONF:
+			capimsg_setu32(m, 8, cmsg->adr.adrNCCI);
+			capimsg_setu16(m, 12, cmsg->DataHandle);
+			capimsg_setu16(m, 14, cmsg->Info);
+			len = CAPI_B3_DATA_CONF_SIZE;
+			break;
+		case CAPI_DISCONNECT_IND:
+			capimsg_setu32(m, 8, cmsg->adr.adrPLCI);
+			capimsg_setu16(m, 12, cmsg->Reason);
+			len = 14;
+			break;
+		case CAPI_INFO_IND:
+			if (cmsg->InfoElement && (cmsg->InfoElement[0] == 0xff))
+				return(0);
+			capimsg_setu32(m, 8, cmsg->adr.adrPLCI);
+			capimsg_setu16(m, 12, cmsg->InfoNumber);
+			len = 14 + put_cstruct(m + 14, cmsg->InfoElement);
+			break;
+		default:
+			return(0);
+	}
+	CAPIMSG_SETLEN(m, len);
+	CAPIMSG_SETAPPID(m, cmsg->ApplId);
+	CAPIMSG_SETCOMMAND(m, cmsg->Command);
+	CAPIMSG_SETSUBCOMMAND(m, cmsg->Subcommand);
+	CAPIMSG_SETMSGID(m, cmsg->Messagenumber);
+	return(len);
+}
+
 void
 SendCmsg2Application(Application_t *appl, _cmsg *cmsg)
 {
@@ -355,7 +433,8 @@ SendCmsg2Application(Application_t *appl, _cmsg *cmsg)
 		int_error();
 		goto free;
 	}
-	capi_cmsg2message(cmsg, skb->data);
+	if (!capi_fast_cmsg2message(cmsg, skb->data))
+		capi_cmsg2message(cmsg, skb->data);
 	applDebug(appl, CAPI_DBG_APPL_MSG, "%s: len(%d) applid(%x) %s msgnr(%d) addr(%08x)",
 		__FUNCTION__, CAPIMSG_LEN(skb->data), cmsg->ApplId, capi_cmd2str(cmsg->Command, cmsg->Subcommand),
 		cmsg->Messagenumber, cmsg->adr.adrController);
@@ -450,7 +529,8 @@ void applManufacturerReqmISDN(Application_t *appl, _cmsg *cmsg, struct sk_buff *
 				ncci = getNCCI4addr(aplci, CAPIMSG_NCCI(skb->data), GET_NCCI_PLCI);
 				if (ncci) {
 					cmsg_free(cmsg);
-					ncciSendMessage(ncci, skb);
+					if (ncciQueueMessage(ncci, skb))
+						ncciSendMessage(ncci, skb);
 					return;
 				}
 			}
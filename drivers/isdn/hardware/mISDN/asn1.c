@@ -6,14 +6,19 @@
 
 int ParseTag(u_char *p, u_char *end, int *tag)
 {
+	if (p >= end)
+		return -1;
 	*tag = *p;
 	return 1;
 }
 
+/* a length must fit in the rest of the buffer, longer forms are rejected */
 int ParseLen(u_char *p, u_char *end, int *len)
 {
 	int l, i;
 
+	if (p >= end)
+		return -1;
 	if (*p == 0x80) { // indefinite
 		*len = -1;
 		return 1;
@@ -22,8 +27,10 @@ int ParseLen(u_char *p, u_char *end, int *len)
 		*len = *p;
 		return 1;
 	}
-	*len = 0;
 	l = *p & ~0x80;
+	if ((l > 2) || (p + 1 + l > end))
+		return -1;
+	*len = 0;
 	p++;
 	for (i = 0; i < l; i++) {
 		*len = (*len << 8) + *p; 
@@ -32,48 +39,70 @@ int ParseLen(u_char *p, u_char *end, int *len)
 	return l+1;
 }
 
+/*
+ * Walk one element and all elements inside it without recursion,
+ * open constructed elements are kept in a stack of ASN1_MAX_LEVEL
+ * entries (their end, NULL for indefinite length).
+ */
 int
 ParseASN1(u_char *p, u_char *end, int level)
 {
-	int tag, len;
-	int ret;
-	int j;
-	u_char *tag_end, *beg;
+	u_char	*stack[ASN1_MAX_LEVEL];
+	int	tag, len;
+	int	ret;
+	int	j, sp = 0;
+	u_char	*beg;
 
 	beg = p;
 
-	CallASN1(ret, p, end, ParseTag(p, end, &tag));
-	CallASN1(ret, p, end, ParseLen(p, end, &len));
+	do {
+		CallASN1(ret, p, end, ParseTag(p, end, &tag));
+		CallASN1(ret, p, end, ParseLen(p, end, &len));
 #ifdef ASN1_DEBUG
-	for (j = 0; j < level*5; j++) print_asn1msg(PRT_DEBUG_DECODE, " ");
-	print_asn1msg(PRT_DEBUG_DECODE, "TAG 0x%02x LEN %3d\n", tag, len);
+		for (j = 0; j < (level + sp)*5; j++) print_asn1msg(PRT_DEBUG_DECODE, " ");
+		print_asn1msg(PRT_DEBUG_DECODE, "TAG 0x%02x LEN %3d\n", tag, len);
 #endif
-	
-	if (tag & ASN1_TAG_CONSTRUCTED) {
-		if (len == -1) { // indefinite
-			while (*p) {
-				CallASN1(ret, p, end, ParseASN1(p, end, level + 1));
-			}
-			p++;
-			if (*p) 
+		if (tag & ASN1_TAG_CONSTRUCTED) {
+			if (sp >= ASN1_MAX_LEVEL)
 				return -1;
-			p++;
+			if (len == -1) { // indefinite
+				stack[sp++] = NULL;
+			} else {
+				if (p + len > end)
+					return -1;
+				stack[sp++] = p + len;
+			}
 		} else {
-			tag_end = p + len;
-			while (p < tag_end) {
-				CallASN1(ret, p, end, ParseASN1(p, end, level +1));
+			if ((len < 0) || (p + len > end))
+				return -1;
+			for (j = 0; j < (level + sp)*5; j++) print_asn1msg(PRT_DEBUG_DECODE, " ");
+			while (len--) {
+				print_asn1msg(PRT_DEBUG_DECODE, "%02x ", *p);
+				p++;
 			}
+			print_asn1msg(PRT_DEBUG_DECODE, "\n");
 		}
-	} else {
-		for (j = 0; j < level*5; j++) print_asn1msg(PRT_DEBUG_DECODE, " ");
-		while (len--) {
-			print_asn1msg(PRT_DEBUG_DECODE, "%02x ", *p);
-			p++;
+		/* close all finished constructed elements */
+		while (sp) {
+			if (stack[sp - 1]) {
+				if (p < stack[sp - 1])
+					break;
+				if (p > stack[sp - 1])
+					return -1;
+			} else {
+				if (p >= end)
+					return -1;
+				if (*p)
+					break;
+				if ((p + 1 >= end) || p[1])
+					return -1;
+				p += 2;
+			}
+			sp--;
+			for (j = 0; j < (level + sp)*5; j++) print_asn1msg(PRT_DEBUG_DECODE, " ");
+			print_asn1msg(PRT_DEBUG_DECODE, "END\n");
 		}
-		print_asn1msg(PRT_DEBUG_DECODE, "\n");
-	}
-	for (j = 0; j < level*5; j++) print_asn1msg(PRT_DEBUG_DECODE, " ");
-	print_asn1msg(PRT_DEBUG_DECODE, "END (%d)\n", p - beg - 2);
+	} while (sp);
 	return p - beg;
 }
 
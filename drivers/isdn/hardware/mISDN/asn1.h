@@ -22,22 +22,28 @@ typedef enum {
 	ReturnErrorP = 3,
 } asn1Problem;
 
+/* size of the string buffers, longer strings are truncated */
+#define ASN1_STR_SIZE	30
+
+/* max nesting of constructed elements in ParseASN1() */
+#define ASN1_MAX_LEVEL	16
+
 struct PublicPartyNumber {
 	int publicTypeOfNumber;
-	char numberDigits[30];
+	char numberDigits[ASN1_STR_SIZE];
 };
 
 struct PartyNumber {
 	int type;
 	union {
-		char unknown[30];
+		char unknown[ASN1_STR_SIZE];
 		struct PublicPartyNumber publicPartyNumber;
 	} p;
 };
 
 struct Address {
 	struct PartyNumber partyNumber;
-	char partySubaddress[30];
+	char partySubaddress[ASN1_STR_SIZE];
 };
 
 struct ServedUserNr {
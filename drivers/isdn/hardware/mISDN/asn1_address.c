@@ -73,7 +73,7 @@ int ParsePresentedNumberUnscreened(struct asn1_parm *pc, u_char *p, u_char *end,
 int ParseNumberScreened(struct asn1_parm *pc, u_char *p, u_char *end, char *str)
 {
 	struct PartyNumber partyNumber;
-	char screeningIndicator[30];
+	char screeningIndicator[ASN1_STR_SIZE];
 	INIT;
 
 	XSEQUENCE_1(ParsePartyNumber, ASN1_NOT_TAGGED, ASN1_NOT_TAGGED, &partyNumber);
@@ -87,8 +87,8 @@ int ParseNumberScreened(struct asn1_parm *pc, u_char *p, u_char *end, char *str)
 int ParseAddressScreened(struct asn1_parm *pc, u_char *p, u_char *end, char *str)
 {
 	struct PartyNumber partyNumber;
-	char partySubaddress[30] = { 0, };
-	char screeningIndicator[30];
+	char partySubaddress[ASN1_STR_SIZE] = { 0, };
+	char screeningIndicator[ASN1_STR_SIZE];
 	INIT;
 
 	XSEQUENCE_1(ParsePartyNumber, ASN1_NOT_TAGGED, ASN1_NOT_TAGGED, &partyNumber);
@@ -123,7 +123,7 @@ ParseARGDiversionInformation(struct asn1_parm *pc, u_char *p, u_char *end, int d
 {
 	char diversionReason[20];
 	int basicService;
-	char servedUserSubaddress[30];
+	char servedUserSubaddress[ASN1_STR_SIZE];
 	char callingAddress[80];
 	char originalCalledNr[80];
 	char lastDivertingNr[80];
@@ -8,14 +8,34 @@
 // ======================================================================
 // general ASN.1
 
+/* integer values must fit into a int */
+#define CHECK_INT_LEN do { \
+	if ((len < 0) || (len > (int)sizeof(int)) || (p + len > end)) \
+		return -1; \
+	} while (0)
+
+/* copy a string, truncated to ASN1_STR_SIZE - 1 characters */
+static int
+ParseString(u_char *p, u_char *end, int len, char *str)
+{
+	int	l;
+
+	if ((len < 0) || (p + len > end))
+		return -1;
+	l = (len < ASN1_STR_SIZE) ? len : ASN1_STR_SIZE - 1;
+	memcpy(str, p, l);
+	str[l] = 0;
+	return len;
+}
+
 int
 ParseBoolean(struct asn1_parm *pc, u_char *p, u_char *end, int *i)
 {
 	INIT;
 
+	CHECK_INT_LEN;
 	*i = 0;
 	while (len--) {
-		CHECK_P;
 		*i = (*i >> 8) + *p;
 		p++;
 	}
@@ -36,9 +56,9 @@ ParseInteger(struct asn1_parm *pc, u_char *p, u_char *end, int *i)
 {
 	INIT;
 
+	CHECK_INT_LEN;
 	*i = 0;
 	while (len--) {
-		CHECK_P;
 		*i = (*i << 8) + *p;
 		p++;
 	}
@@ -51,9 +71,9 @@ ParseEnum(struct asn1_parm *pc, u_char *p, u_char *end, int *i)
 {
 	INIT;
 
+	CHECK_INT_LEN;
 	*i = 0;
 	while (len--) {
-		CHECK_P;
 		*i = (*i << 8) + *p;
 		p++;
 	}
@@ -85,15 +105,8 @@ ParseNumericString(struct asn1_parm *pc, u_char *p, u_char *end, char *str)
 {
 	INIT;
 
-	print_asn1msg(PRT_DEBUG_DECODE, " DEBUG> NumStr = ");
-	while (len--) {
-		CHECK_P;
-		print_asn1msg(PRT_DEBUG_DECODE, "%c", *p);
-		*str++ = *p;
-		p++;
-	}
-	print_asn1msg(PRT_DEBUG_DECODE, "\n");
-	*str = 0;
+	CallASN1(ret, p, end, ParseString(p, end, len, str));
+	print_asn1msg(PRT_DEBUG_DECODE, " DEBUG> NumStr = %s\n", str);
 	return p - beg;
 }
 
@@ -102,14 +115,7 @@ ParseOctetString(struct asn1_parm *pc, u_char *p, u_char *end, char *str)
 {
 	INIT;
 
-	print_asn1msg(PRT_DEBUG_DECODE, " DEBUG> Octets = ");
-	while (len--) {
-		CHECK_P;
-		print_asn1msg(PRT_DEBUG_DECODE, " %02x", *p);
-		*str++ = *p;
-		p++;
-	}
-	print_asn1msg(PRT_DEBUG_DECODE, "\n");
-	*str = 0;
+	CallASN1(ret, p, end, ParseString(p, end, len, str));
+	print_asn1msg(PRT_DEBUG_DECODE, " DEBUG> Octets = %d\n", ret);
 	return p - beg;
 }
@@ -24,6 +24,7 @@
 #include "isac.h"
 #include "layer1.h"
 #include "debug.h"
+#include "irq_bh.h"
 
 
 static const char *avm_fritz_rev = "$Revision: 1.43 $";
@@ -149,6 +150,8 @@ typedef struct _fritzpnppci {
 	channel_t		dch;
 	channel_t		bch[2];
 	u_char			ctrlreg;
+	mISDN_irq_bh_t		bh;
+	int			sval;	/* saved by hardirq for the bottom half, -1 none */
 } fritzpnppci;
 
 
@@ -218,22 +221,35 @@ static void
 fcpci2_read_isac_fifo(void *fc, unsigned char * data, int size)
 {
 	register long addr = ((fritzpnppci *)fc)->addr;
-	int i;
+	int i, cnt;
+	u32 buf[32];
 
+	/* one 32 bit read per FIFO byte, done as string I/O */
 	outl(0, addr + AVM_ISACSX_INDEX);
-	for (i = 0; i < size; i++)
-		data[i] = inl(addr + AVM_ISACSX_DATA);
+	while (size > 0) {
+		cnt = (size > 32) ? 32 : size;
+		insl(addr + AVM_ISACSX_DATA, buf, cnt);
+		for (i = 0; i < cnt; i++)
+			*data++ = buf[i];
+		size -= cnt;
+	}
 }
 
 static void
 fcpci2_write_isac_fifo(void *fc, unsigned char * data, int size)
 {
 	register long addr = ((fritzpnppci *)fc)->addr;
-	int i;
+	int i, cnt;
+	u32 buf[32];
 
 	outl(0, addr + AVM_ISACSX_INDEX);
-	for (i = 0; i < size; i++)
-		outl(data[i], addr + AVM_ISACSX_DATA);
+	while (size > 0) {
+		cnt = (size > 32) ? 32 : size;
+		for (i = 0; i < cnt; i++)
+			buf[i] = *data++;
+		outsl(addr + AVM_ISACSX_DATA, buf, cnt);
+		size -= cnt;
+	}
 }
 
 static inline
@@ -690,14 +706,91 @@ HDLC_irq_main(fritzpnppci *fc)
 	}
 }
 
+static int irq_bh;	/* use the common bottom half, module parameter */
+
+static void
+avm_fritz_handle_int(fritzpnppci *fc, u_char sval)
+{
+	u_char val;
+
+	if (!(sval & AVM_STATUS0_IRQ_ISAC)) {
+		val = ReadISAC(fc, ISAC_ISTA);
+		mISDN_isac_interrupt(&fc->dch, val);
+	}
+	if (!(sval & AVM_STATUS0_IRQ_HDLC)) {
+		HDLC_irq_main(fc);
+	}
+	if (fc->type == AVM_FRITZ_PNP) {
+		WriteISAC(fc, ISAC_MASK, 0xFF);
+		WriteISAC(fc, ISAC_MASK, 0x0);
+	}
+}
+
+static void
+avm_fritzv2_handle_int(fritzpnppci *fc, u_char sval)
+{
+	u_char val;
+
+	if (sval & AVM_STATUS0_IRQ_HDLC) {
+		HDLC_irq_main(fc);
+	}
+	if (sval & AVM_STATUS0_IRQ_ISAC) {
+		val = fcpci2_read_isac(fc, ISACSX_ISTA);
+		mISDN_isac_interrupt(&fc->dch, val);
+	}
+	if (sval & AVM_STATUS0_IRQ_TIMER) {
+		if (fc->dch.debug & L1_DEB_INTSTAT)
+			mISDN_debugprint(&fc->dch.inst, "Fc2 timer irq");
+		outb(fc->ctrlreg | AVM_STATUS0_RES_TIMER, fc->addr + 2);
+		udelay(1);
+		outb(fc->ctrlreg, fc->addr + 2);
+	}
+}
+
+/*
+ * bottom half for the PCI cards, one work unit is one status read,
+ * the card interrupt stays disabled until all is done
+ */
+static int
+avm_fritz_bh_work(mISDN_irq_bh_t *bh, int budget)
+{
+	fritzpnppci	*fc = bh->priv;
+	u_char		sval;
+	u_long		flags;
+	int		cnt = 0;
+
+	spin_lock_irqsave(&fc->lock, flags);
+	while (cnt < budget) {
+		if (fc->sval >= 0) {
+			sval = fc->sval;
+			fc->sval = -1;
+		} else
+			sval = inb(fc->addr + 2);
+		if (fc->type == AVM_FRITZ_PCIV2) {
+			if (!(sval & AVM_STATUS0_IRQ_MASK))
+				break;
+			avm_fritzv2_handle_int(fc, sval);
+		} else {
+			if ((sval & AVM_STATUS0_IRQ_MASK) == AVM_STATUS0_IRQ_MASK)
+				break;
+			avm_fritz_handle_int(fc, sval);
+		}
+		cnt++;
+	}
+	if (cnt < budget)
+		enable_hwirq(fc);
+	spin_unlock_irqrestore(&fc->lock, flags);
+	return(cnt);
+}
+
 static irqreturn_t
 avm_fritz_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 {
 	fritzpnppci	*fc = dev_id;
-	u_char val;
 	u_char sval;
 
 	spin_lock(&fc->lock);
+	mISDN_irq_bh_enter(&fc->bh);
 	sval = inb(fc->addr + 2);
 	if (fc->dch.debug & L1_DEB_INTSTAT)
 		mISDN_debugprint(&fc->dch.inst, "irq stat0 %x", sval);
@@ -707,18 +800,14 @@ avm_fritz_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 		return IRQ_NONE;
 	}
 	fc->irqcnt++;
-
-	if (!(sval & AVM_STATUS0_IRQ_ISAC)) {
-		val = ReadISAC(fc, ISAC_ISTA);
-		mISDN_isac_interrupt(&fc->dch, val);
-	}
-	if (!(sval & AVM_STATUS0_IRQ_HDLC)) {
-		HDLC_irq_main(fc);
-	}
-	if (fc->type == AVM_FRITZ_PNP) {
-		WriteISAC(fc, ISAC_MASK, 0xFF);
-		WriteISAC(fc, ISAC_MASK, 0x0);
-	}
+	/* the PnP card is not shared and needs the ISAC mask toggle */
+	if (irq_bh && (fc->type == AVM_FRITZ_PCI)) {
+		disable_hwirq(fc);
+		fc->sval = sval;
+		mISDN_irq_bh_schedule(&fc->bh);
+	} else
+		avm_fritz_handle_int(fc, sval);
+	mISDN_irq_bh_leave(&fc->bh);
 	spin_unlock(&fc->lock);
 	return IRQ_HANDLED;
 }
@@ -727,10 +816,10 @@ static irqreturn_t
 avm_fritzv2_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 {
 	fritzpnppci	*fc = dev_id;
-	u_char val;
 	u_char sval;
 
 	spin_lock(&fc->lock);
+	mISDN_irq_bh_enter(&fc->bh);
 	sval = inb(fc->addr + 2);
 	if (fc->dch.debug & L1_DEB_INTSTAT)
 		mISDN_debugprint(&fc->dch.inst, "irq stat0 %x", sval);
@@ -740,21 +829,13 @@ avm_fritzv2_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 		return IRQ_NONE;
 	}
 	fc->irqcnt++;
-
-	if (sval & AVM_STATUS0_IRQ_HDLC) {
-		HDLC_irq_main(fc);
-	}
-	if (sval & AVM_STATUS0_IRQ_ISAC) {
-		val = fcpci2_read_isac(fc, ISACSX_ISTA);
-		mISDN_isac_interrupt(&fc->dch, val);
-	}
-	if (sval & AVM_STATUS0_IRQ_TIMER) {
-		if (fc->dch.debug & L1_DEB_INTSTAT)
-			mISDN_debugprint(&fc->dch.inst, "Fc2 timer irq");
-		outb(fc->ctrlreg | AVM_STATUS0_RES_TIMER, fc->addr + 2);
-		udelay(1);
-		outb(fc->ctrlreg, fc->addr + 2);
-	}
+	if (irq_bh) {
+		disable_hwirq(fc);
+		fc->sval = sval;
+		mISDN_irq_bh_schedule(&fc->bh);
+	} else
+		avm_fritzv2_handle_int(fc, sval);
+	mISDN_irq_bh_leave(&fc->bh);
 	spin_unlock(&fc->lock);
 	return IRQ_HANDLED;
 }
@@ -955,11 +1036,13 @@ MODULE_LICENSE("GPL");
 
 #ifdef OLD_MODULE_PARAM
 MODULE_PARM(debug, "1i");
+MODULE_PARM(irq_bh, "1i");
 #define MODULE_PARM_T   "1-4i"
 MODULE_PARM(protocol, MODULE_PARM_T);
 MODULE_PARM(layermask, MODULE_PARM_T);
 #else
 module_param(debug, uint, S_IRUGO | S_IWUSR);
+module_param(irq_bh, uint, S_IRUGO);
 
 #ifdef OLD_MODULE_PARAM_ARRAY
 static int num_protocol=0,num_layermask=0;
@@ -1046,6 +1129,7 @@ release_card(fritzpnppci *card)
 {
 	u_long		flags;
 
+	mISDN_irq_bh_kill(&card->bh);
 	disable_hwirq(card);
 	spin_lock_irqsave(&card->lock, flags);
 	modehdlc(&card->bch[0], 0, ISDN_PID_NONE);
@@ -1236,6 +1320,9 @@ static int __devinit setup_instance(fritzpnppci *card)
 		kfree(card);
 		return(err);
 	}
+	card->sval = -1;
+	mISDN_irq_bh_init(&card->bh, card->dch.inst.name, avm_fritz_bh_work,
+		card, MISDN_BH_BUDGET);
 	fritz_cnt++;
 	err = mISDN_ctrl(NULL, MGR_NEWSTACK | REQUEST, &card->dch.inst);
 	if (err) {
@@ -23,6 +23,7 @@ mISDN_initchannel(channel_t *ch, ulong prop, int maxlen)
 	ch->maxlen = maxlen;
 	ch->hw = NULL;
 	ch->rx_skb = NULL;
+	skb_queue_head_init(&ch->rx_chain);
 	ch->tx_skb = NULL;
 	ch->tx_idx = 0;
 	ch->next_skb = NULL;
@@ -44,6 +45,7 @@ mISDN_freechannel(channel_t *ch)
 		dev_kfree_skb(ch->next_skb);
 		ch->next_skb = NULL;
 	}
+	discard_queue(&ch->rx_chain);
 	kfree(ch->log);
 	ch->log = NULL;
 	return(0);
@@ -83,6 +85,46 @@ mISDN_setpara(channel_t *ch, mISDN_stPara_t *stp)
 	return(0);
 }
 
+/*
+ * the first frame carries the chain, all other frames are linked on its
+ * frag_list, nothing is copied
+ */
+void
+mISDN_flush_chain(channel_t *ch)
+{
+	struct sk_buff	*skb, *fskb, **last;
+	int		cnt = 1;
+
+	if (!test_bit(FLG_RX_CHAIN, &ch->Flags)) {
+		/* layer2 switched chaining off meanwhile */
+		while ((skb = skb_dequeue(&ch->rx_chain))) {
+			if (mISDN_queueup_newhead(&ch->inst, 0, PH_DATA_IND,
+				MISDN_ID_ANY, skb)) {
+				int_error();
+				dev_kfree_skb(skb);
+			}
+		}
+		return;
+	}
+	if (!(skb = skb_dequeue(&ch->rx_chain)))
+		return;
+	last = &skb_shinfo(skb)->frag_list;
+	while ((fskb = skb_dequeue(&ch->rx_chain))) {
+		*last = fskb;
+		last = &fskb->next;
+		skb->len += fskb->len;
+		skb->data_len += fskb->len;
+		skb->truesize += fskb->truesize;
+		cnt++;
+	}
+	if (mISDN_queueup_newhead(&ch->inst, 0, (cnt > 1) ? PH_DATA_CHAIN_IND :
+		PH_DATA_IND, (cnt > 1) ? cnt : MISDN_ID_ANY, skb)) {
+		int_error();
+		dev_kfree_skb(skb);
+	}
+}
+
 EXPORT_SYMBOL(mISDN_initchannel);
 EXPORT_SYMBOL(mISDN_freechannel);
 EXPORT_SYMBOL(mISDN_setpara);
+EXPORT_SYMBOL(mISDN_flush_chain);
@@ -29,6 +29,7 @@
 #define FLG_TX_BUSY		0	// tx_buf in use
 #define FLG_TX_NEXT		1	// next_skb in use
 #define FLG_L1_BUSY		2	// L1 is permanent busy
+#define FLG_RX_CHAIN		3	// chain received D-channel frames
 #define FLG_USED		5	// channel is in use		
 #define FLG_ACTIVE		6	// channel is activated
 #define FLG_BUSY_TIMER		7
@@ -78,6 +79,7 @@ typedef struct _channel_t {
 	struct timer_list	timer;
 	/* receive data */
 	struct sk_buff		*rx_skb;
+	struct sk_buff_head	rx_chain;
 	int			maxlen;
 	int			up_headerlen;
 	/* send data */
@@ -96,6 +98,7 @@ typedef struct _channel_t {
 extern int	mISDN_initchannel(channel_t *, ulong, int);
 extern int	mISDN_freechannel(channel_t *);
 extern int	mISDN_setpara(channel_t *, mISDN_stPara_t *);
+extern void	mISDN_flush_chain(channel_t *);
 
 static inline void
 queue_ch_frame(channel_t *ch, u_int pr, int dinfo, struct sk_buff *skb)
@@ -120,6 +123,45 @@ queue_ch_frame(channel_t *ch, u_int pr, int dinfo, struct sk_buff *skb)
 	}
 }
 
+/*
+ * D-channel frames received in one interrupt are collected with
+ * queue_ch_dframe() and sent up as one PH_DATA_CHAIN_IND by
+ * flush_ch_frames(), if layer2 asked for it with HW_D_CHAIN_ON;
+ * drivers which handle HW_D_CHAIN_ON set EXT_INST_DCHAIN on the
+ * D-channel instance
+ */
+static inline void
+queue_ch_dframe(channel_t *ch, struct sk_buff *skb)
+{
+	if (!test_bit(FLG_RX_CHAIN, &ch->Flags)) {
+		queue_ch_frame(ch, INDICATION, MISDN_ID_ANY, skb);
+		return;
+	}
+#ifdef CONFIG_MISDN_NETDEV
+	misdn_log_frame(ch->inst.st, skb->data, skb->len, FLG_MSG_UP);
+#endif
+	mISDN_dt_new_frame(ch->inst.st, D_RX, skb, 1);
+	skb_queue_tail(&ch->rx_chain, skb);
+}
+
+static inline void
+flush_ch_frames(channel_t *ch)
+{
+	if (!skb_queue_empty(&ch->rx_chain))
+		mISDN_flush_chain(ch);
+}
+
+/*
+ * HW_D_CHAIN_OFF, D-channel reset or deactivated: frames go up as single
+ * PH_DATA_IND again, layer2 asks with HW_D_CHAIN_ON on the next activation
+ */
+static inline void
+stop_ch_chain(channel_t *ch)
+{
+	if (test_and_clear_bit(FLG_RX_CHAIN, &ch->Flags))
+		flush_ch_frames(ch);
+}
+
 static inline int
 channel_senddata(channel_t *ch, int di, struct sk_buff *skb)
 {
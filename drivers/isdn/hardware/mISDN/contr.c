@@ -35,6 +35,8 @@ ControllerDestr(Controller_t *contr)
 	struct list_head	*item, *next;
 	u_long			flags;
 
+	/* the timer handler takes the list_lock */
+	del_timer_sync(&contr->ss_timer);
 	spin_lock_irqsave(&contr->list_lock, flags);
 	list_for_each_safe(item, next, &contr->Applications) {
 		ApplicationDestr(list_entry(item, Application_t, head), 3);
@@ -63,7 +65,7 @@ ControllerDestr(Controller_t *contr)
 		contr->plcis = NULL;
 	}
 	list_for_each_safe(item, next, &contr->SSProcesse) {
-		SSProcessDestr(list_entry(item, SSProcess_t, head));
+		__SSProcessDestr(list_entry(item, SSProcess_t, head));
 	}
 #ifdef OLDCAPI_DRIVER_INTERFACE
 	if (contr->ctrl)
@@ -169,16 +171,9 @@ ControllerRun(Controller_t *contr)
 Application_t
 *getApplication4Id(Controller_t *contr, __u16 ApplId)
 {
-	struct list_head	*item;
-	Application_t		*ap = NULL;
-
-	list_for_each(item, &contr->Applications) {
-		ap = (Application_t *)item;
-		if (ap->ApplId == ApplId)
-			break;
-		ap = NULL;
-	}
-	return(ap);
+	if ((ApplId < 1) || (ApplId > CAPI_MAXAPPL))
+		return(NULL);
+	return(contr->appltab[ApplId]);
 }
 
 Plci_t
@@ -401,7 +396,7 @@ ResetController(struct capi_ctr *ctrl)
 		ApplicationDestr((Application_t *)item, 2);
 	}
 	list_for_each_safe(item, next, &contr->SSProcesse) {
-		SSProcessDestr((SSProcess_t *)item);
+		__SSProcessDestr((SSProcess_t *)item);
 	}
 	spin_unlock_irqrestore(&contr->list_lock, flags);
 #ifdef OLDCAPI_DRIVER_INTERFACE
@@ -454,40 +449,85 @@ ControllerD2Trace(Controller_t *contr, u_char *buf, int len)
 static __inline__ Plci_t *
 getPlci4L3id(Controller_t *contr, u_int l3id)
 {
-	Plci_t	*plci = contr->plcis;
-	int	i;
+	Plci_t	*plci;
+	u_long	flags;
 
-	for (i = 0; i < contr->maxplci; i++) {
-		if (test_bit(PLCI_STATE_ACTIV, &plci->state) &&
-			(plci->l3id == l3id))
-			return(plci);
-		plci++;
+	spin_lock_irqsave(&contr->plci_lock, flags);
+	plci = contr->plci_l3hash[CAPI_PLCI_L3HASH_IDX(l3id)];
+	while (plci) {
+		if (plci->l3id == l3id)
+			break;
+		plci = plci->l3next;
 	}
-	return(NULL);
+	spin_unlock_irqrestore(&contr->plci_lock, flags);
+	return(plci);
+}
+
+/*
+ * the l3id hash contains only activ PLCIs, a PLCI is added after
+ * the l3id was assigned and removed before it is released
+ */
+static void
+plci_l3hash_add(Controller_t *contr, Plci_t *plci)
+{
+	Plci_t	**pp = &contr->plci_l3hash[CAPI_PLCI_L3HASH_IDX(plci->l3id)];
+	u_long	flags;
+
+	spin_lock_irqsave(&contr->plci_lock, flags);
+	plci->l3next = *pp;
+	*pp = plci;
+	spin_unlock_irqrestore(&contr->plci_lock, flags);
+}
+
+static void
+plci_l3hash_del(Controller_t *contr, Plci_t *plci)
+{
+	Plci_t	**pp = &contr->plci_l3hash[CAPI_PLCI_L3HASH_IDX(plci->l3id)];
+	u_long	flags;
+
+	spin_lock_irqsave(&contr->plci_lock, flags);
+	while (*pp) {
+		if (*pp == plci) {
+			*pp = plci->l3next;
+			break;
+		}
+		pp = &(*pp)->l3next;
+	}
+	plci->l3next = NULL;
+	spin_unlock_irqrestore(&contr->plci_lock, flags);
+}
+
+static void
+plci_free(Controller_t *contr, Plci_t *plci)
+{
+	if (!test_and_clear_bit(PLCI_STATE_ACTIV, &plci->state))
+		int_errtxt("PLCI(%x) was not activ", plci->addr);
+	clear_bit(plci - contr->plcis, contr->plci_used);
 }
 
 int
 ControllerNewPlci(Controller_t *contr, Plci_t  **plci_p, u_int l3id)
 {
 	int	i;
-	Plci_t	*plci = contr->plcis;
+	Plci_t	*plci;
 
-	for (i = 0; i < contr->maxplci; i++) {
-		if (!test_and_set_bit(PLCI_STATE_ACTIV, &plci->state))
-			break;
-		plci++;
-	}
-	if (i == contr->maxplci) {
-		contrDebug(contr, CAPI_DBG_PLCI, "%s: no free PLCI",
-			__FUNCTION__);
-		return(-EBUSY); //FIXME
-	}
+	/* free PLCIs are tracked in the plci_used bitmap */
+	do {
+		i = find_first_zero_bit(contr->plci_used, contr->maxplci);
+		if (i >= contr->maxplci) {
+			contrDebug(contr, CAPI_DBG_PLCI, "%s: no free PLCI",
+				__FUNCTION__);
+			return(-EBUSY); //FIXME
+		}
+	} while (test_and_set_bit(i, contr->plci_used));
+	plci = &contr->plcis[i];
+	test_and_set_bit(PLCI_STATE_ACTIV, &plci->state);
 	*plci_p = plci;
 	if (l3id == MISDN_ID_ANY) {
 		if (contr->entity == MISDN_ENTITY_NONE) {
 			printk(KERN_ERR "mISDN %s: no ENTITY id\n",
 				__FUNCTION__);
-			test_and_clear_bit(PLCI_STATE_ACTIV, &plci->state);
+			plci_free(contr, plci);
 			return(-EINVAL); //FIXME
 		}
 		plci->l3id = (contr->entity << 16) | plci->addr;
@@ -496,12 +536,13 @@ ControllerNewPlci(Controller_t *contr, Plci_t  **plci_p, u_int l3id)
 		if (plci) {
 			printk(KERN_WARNING "mISDN %s: PLCI(%x) allready has l3id(%x)\n",
 				__FUNCTION__, plci->addr, l3id);
-			test_and_clear_bit(PLCI_STATE_ACTIV, &(*plci_p)->state);
+			plci_free(contr, *plci_p);
 			return(-EBUSY); 
 		}
 		plci = *plci_p;
 		plci->l3id = l3id;
 	}
+	plci_l3hash_add(contr, plci);
 	contrDebug(contr, CAPI_DBG_PLCI, "%s: PLCI(%x) plci(%p,%d) id(%x)",
 		__FUNCTION__, plci->addr, plci, sizeof(*plci), plci->l3id);
 	return(0);
@@ -525,9 +566,9 @@ ControllerReleasePlci(Plci_t *plci)
 	}
 	test_and_clear_bit(PLCI_STATE_ALERTING, &plci->state);
 	test_and_clear_bit(PLCI_STATE_OUTGOING, &plci->state);
+	plci_l3hash_del(plci->contr, plci);
 	plci->l3id = MISDN_ID_NONE;
-	if (!test_and_clear_bit(PLCI_STATE_ACTIV, &plci->state))
-		int_errtxt("PLCI(%x) was not activ", plci->addr);
+	plci_free(plci->contr, plci);
 	return(0);
 }
 
@@ -542,7 +583,7 @@ ControllerAddSSProcess(Controller_t *contr, SSProcess_t *sp)
 	spin_lock_irqsave(&contr->list_lock, flags);
 	contr->LastInvokeId++;
 	sp->invokeId = contr->LastInvokeId;
-	list_add(&sp->head, &contr->SSProcesse);
+	list_add_tail(&sp->head, &contr->SSProcesse);
 	spin_unlock_irqrestore(&contr->list_lock, flags);
 }
 
@@ -551,13 +592,23 @@ SSProcess_t
 {
 	struct list_head	*item;
 	SSProcess_t		*sp = NULL;
+	u_long			flags;
 
+	/*
+	 * the process is taken from the list, so the timer cannot expire it
+	 * anymore, the caller must destroy it
+	 */
+	spin_lock_irqsave(&contr->list_lock, flags);
 	list_for_each(item, &contr->SSProcesse) {
 		sp = (SSProcess_t *)item;
-		if (sp->invokeId == id)
+		if (sp->invokeId == id) {
+			sp->expires = 0;
+			list_del_init(&sp->head);
 			break;
+		}
 		sp = NULL;
 	}
+	spin_unlock_irqrestore(&contr->list_lock, flags);
 	return(sp);
 }
 
@@ -646,6 +697,10 @@ ControllerConstr(Controller_t **contr_p, mISDNstack_t *st, mISDN_pid_t *pid, mIS
 	INIT_LIST_HEAD(&contr->SSProcesse);
 	INIT_LIST_HEAD(&contr->linklist);
 	spin_lock_init(&contr->list_lock);
+	spin_lock_init(&contr->plci_lock);
+	init_timer(&contr->ss_timer);
+	contr->ss_timer.function = SSProcessTimeout;
+	contr->ss_timer.data = (u_long) contr;
 	contr->next_id = 1;
 	memcpy(&contr->inst.pid, pid, sizeof(mISDN_pid_t));
 #ifndef OLDCAPI_DRIVER_INTERFACE
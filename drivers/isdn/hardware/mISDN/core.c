@@ -12,6 +12,8 @@
 #include <linux/spinlock.h>
 #include <linux/sched.h>
 #include "core.h"
+#include "sw_hdlc.h"
+#include "irq_bh.h"
 #ifdef CONFIG_KMOD
 #include <linux/kmod.h>
 #endif
@@ -31,11 +33,13 @@ struct modulelist {
 };
 
 int core_debug;
+int core_stack_nice;
 
 static u_char		entityarray[MISDN_MAX_ENTITY/8];
 static DEFINE_SPINLOCK(entity_lock);
 
 static uint debug;
+static int stack_nice = 0;
 static int obj_id;
 
 static int dt_enabled = 0;
@@ -47,10 +51,13 @@ MODULE_LICENSE("GPL");
 #endif
 #ifdef OLD_MODULE_PARAM
 MODULE_PARM(debug, "1i");
+MODULE_PARM(stack_nice, "1i");
 #else
 module_param (debug, uint, S_IRUGO | S_IWUSR);
+module_param (stack_nice, int, S_IRUGO);
 #endif
 MODULE_PARM_DESC (debug, "mISDN core debug mask");
+MODULE_PARM_DESC (stack_nice, "nice value of the D-channel stack threads (0 = unchanged)");
 #endif
 
 typedef struct _mISDN_thread {
@@ -774,6 +781,10 @@ mISDNInit(void)
 
 	printk(KERN_INFO "Modular ISDN Stack core version (%s) revision (%s)\n", mISDN_core_version, mISDN_core_revision);
 	core_debug = debug;
+	if (stack_nice < -20 || stack_nice > 19)
+		stack_nice = 0;
+	core_stack_nice = stack_nice;
+	mISDN_hdlc_init();
 #ifdef MISDN_MEMDEBUG
 	err = __mid_init();
 	if (err)
@@ -839,6 +850,7 @@ void mISDN_cleanup(void) {
 	misdn_netdev_exit();
 #endif
 	
+	mISDN_irq_bh_cleanup();
 	mISDN_sysfs_cleanup();
 	printk(KERN_DEBUG "mISDNcore unloaded\n");
 }
@@ -78,6 +78,7 @@ extern void		mISDN_sysfs_st_cleanup(void);
 
 /* from core.c */
 extern int core_debug;
+extern int core_stack_nice;
 extern int		register_layer(mISDNstack_t *, mISDNinstance_t *);
 extern int		preregister_layer(mISDNstack_t *, mISDNinstance_t *);
 extern int		unregister_instance(mISDNinstance_t *);
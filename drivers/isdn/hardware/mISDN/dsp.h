@@ -125,6 +125,7 @@ typedef struct _conference {
 	struct list_head	mlist;
 	int			software; /* conf is processed by software */
 	int			hardware; /* conf is processed by hardware */
+	int			hw_wait; /* software, because no slot/unit was free */
 } conference_t;
 
 extern mISDNobject_t dsp_obj;
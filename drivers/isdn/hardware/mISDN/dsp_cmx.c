@@ -133,6 +133,40 @@
 
 LIST_HEAD(Conf_list);
 
+/*
+ * placement statistics, counted for each decision of dsp_cmx_hardware()
+ *
+ * hw_xconnect:	crossconnect of two members got PCM slot(s)
+ * hw_conf:	member joined a HFC conference
+ * hw_echo:	echo got a PCM slot
+ * sw_conf:	conference is mixed in software due to the member features
+ * sw_noslot:	conference or echo is done in software, no slot or unit free
+ * rebalanced:	waiting conference got hardware after resources were released
+ */
+static u_long cmx_hw_xconnect, cmx_hw_conf, cmx_hw_echo;
+static u_long cmx_sw_conf, cmx_sw_noslot, cmx_rebalanced;
+
+/* count of PCM slot and conference unit releases */
+static u_long cmx_released;
+
+#ifdef MODULE
+#ifdef OLD_MODULE_PARAM
+MODULE_PARM(cmx_hw_xconnect, "1l");
+MODULE_PARM(cmx_hw_conf, "1l");
+MODULE_PARM(cmx_hw_echo, "1l");
+MODULE_PARM(cmx_sw_conf, "1l");
+MODULE_PARM(cmx_sw_noslot, "1l");
+MODULE_PARM(cmx_rebalanced, "1l");
+#else
+module_param(cmx_hw_xconnect, ulong, S_IRUGO);
+module_param(cmx_hw_conf, ulong, S_IRUGO);
+module_param(cmx_hw_echo, ulong, S_IRUGO);
+module_param(cmx_sw_conf, ulong, S_IRUGO);
+module_param(cmx_sw_noslot, ulong, S_IRUGO);
+module_param(cmx_rebalanced, ulong, S_IRUGO);
+#endif
+#endif
+
 /*
  * debug cmx memory structure
  */
@@ -163,6 +197,10 @@ dsp_cmx_debug(dsp_t *dsp)
 				(member->dsp==dsp)?" *this*":"");
 		}
 	}
+	printk(KERN_DEBUG "-----Placement: hw_xconnect %lu hw_conf %lu hw_echo %lu "
+		"sw_conf %lu sw_noslot %lu rebalanced %lu\n", cmx_hw_xconnect,
+		cmx_hw_conf, cmx_hw_echo, cmx_sw_conf, cmx_sw_noslot,
+		cmx_rebalanced);
 	printk(KERN_DEBUG "-----end\n");
 }
 
@@ -348,6 +386,47 @@ dsp_cmx_hw_message(dsp_t *dsp, u32 message, u32 param1, u32 param2, u32 param3,
 	/* unlocking is not required, because we don't expect a response */
 	if (mISDN_queue_down(&dsp->inst, 0, nskb))
 		dev_kfree_skb(nskb);
+	if (message == HW_PCM_DISC || message == HW_CONF_SPLIT)
+		cmx_released++;
+}
+
+
+/*
+ * PCM slot allocation
+ *
+ * The slots of one PCM bus are shared by all dsp instances on this bus,
+ * so the used slots are collected from all instances. The instances
+ * skip1 and skip2 are not checked, because they get new slots.
+ */
+static void
+dsp_cmx_pcm_used(u_char *freeslots, int pcm_id, dsp_t *skip1, dsp_t *skip2)
+{
+	dsp_t	*dsp;
+
+	memset(freeslots, 1, 256);
+	list_for_each_entry(dsp, &dsp_obj.ilist, list) {
+		if (dsp == skip1 || dsp == skip2
+		 || dsp->features.pcm_id != pcm_id)
+			continue;
+		if (dsp->pcm_slot_tx >= 0 && dsp->pcm_slot_tx < 256)
+			freeslots[dsp->pcm_slot_tx] = 0;
+		if (dsp->pcm_slot_rx >= 0 && dsp->pcm_slot_rx < 256)
+			freeslots[dsp->pcm_slot_rx] = 0;
+	}
+}
+
+/* returns the lowest free slot from start on or -1 */
+static int
+dsp_cmx_pcm_find(u_char *freeslots, int start, int slots)
+{
+	int	i;
+
+	if (slots > 256)
+		slots = 256;
+	for (i = start; i < slots; i++)
+		if (freeslots[i])
+			return(i);
+	return(-1);
 }
 
 
@@ -359,15 +438,15 @@ dsp_cmx_hw_message(dsp_t *dsp, u32 message, u32 param1, u32 param2, u32 param3,
  * and therefore removed. if a conference is given, the dsp is expected to
  * be member of that conference.
  */
-void 
-dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
+static void
+dsp_cmx_hw_update(conference_t *conf, dsp_t *dsp)
 {
 	conf_member_t	*member, *nextm;
-	dsp_t		*finddsp;
 	int		memb = 0, i, ii, i1, i2;
 	int		freeunits[8];
 	u_char		freeslots[256];
 	int		same_hfc = -1, same_pcm = -1, current_conf = -1, all_conf = 1;
+	int		noslot = 0;
 
 	/* dsp gets updated (no conf) */
 //printk("-----1\n");
@@ -417,28 +496,13 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 		/* ECHO: find slot */
 		dsp->pcm_slot_tx = -1;
 		dsp->pcm_slot_rx = -1;
-		memset(freeslots, 1, sizeof(freeslots));
-		list_for_each_entry(finddsp, &dsp_obj.ilist, list) {
-			 if (finddsp->features.pcm_id==dsp->features.pcm_id) {
-				if (finddsp->pcm_slot_rx>=0
-				 && finddsp->pcm_slot_rx<sizeof(freeslots))
-					freeslots[finddsp->pcm_slot_tx] = 0;
-				if (finddsp->pcm_slot_tx>=0
-				 && finddsp->pcm_slot_tx<sizeof(freeslots))
-					freeslots[finddsp->pcm_slot_rx] = 0;
-			}
-		}
-		i = 0;
-		ii = dsp->features.pcm_slots;
-		while(i < ii) {
-			if (freeslots[i])
-				break;
-			i++;
-		}
-		if (i == ii) {
+		dsp_cmx_pcm_used(freeslots, dsp->features.pcm_id, dsp, NULL);
+		i = dsp_cmx_pcm_find(freeslots, 0, dsp->features.pcm_slots);
+		if (i < 0) {
 			if (dsp_debug & DEBUG_DSP_CMX)
 				printk(KERN_DEBUG "%s no slot available for echo\n", __FUNCTION__);
 			/* no more slots available */
+			cmx_sw_noslot++;
 			return;
 		}
 		/* assign free slot */
@@ -449,6 +513,7 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 		if (dsp_debug & DEBUG_DSP_CMX)
 			printk(KERN_DEBUG "%s assign echo for %s using slot %d\n", __FUNCTION__, dsp->inst.name, dsp->pcm_slot_tx);
 		dsp_cmx_hw_message(dsp, HW_PCM_CONN, dsp->pcm_slot_tx, 2, dsp->pcm_slot_rx, 2);
+		cmx_hw_echo++;
 		return;
 	}
 
@@ -462,6 +527,7 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 		printk(KERN_ERR "%s: conference whithout members\n", __FUNCTION__);
 		return;
 	}
+	conf->hw_wait = 0;
 	member = list_entry(conf->mlist.next, conf_member_t, list);
 	same_hfc = member->dsp->features.hfc_id;
 	same_pcm = member->dsp->features.pcm_id;
@@ -495,6 +561,12 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 			}
 			conf->hardware = 0;
 			conf->software = 1;
+			if (noslot) {
+				/* try again, if slots or units are released */
+				conf->hw_wait = 1;
+				cmx_sw_noslot++;
+			} else
+				cmx_sw_conf++;
 			return;
 		}
 		/* check if member has echo turned on */
@@ -619,31 +691,16 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 				return;
 			}
 			/* find a new slot */
-			memset(freeslots, 1, sizeof(freeslots));
-			list_for_each_entry(dsp, &dsp_obj.ilist, list) {
-				if (dsp!=member->dsp
-				 && dsp!=nextm->dsp
-				 && member->dsp->features.pcm_id==dsp->features.pcm_id) {
-					if (dsp->pcm_slot_rx>=0
-					 && dsp->pcm_slot_rx<sizeof(freeslots))
-						freeslots[dsp->pcm_slot_tx] = 0;
-					if (dsp->pcm_slot_tx>=0
-					 && dsp->pcm_slot_tx<sizeof(freeslots))
-						freeslots[dsp->pcm_slot_rx] = 0;
-				}
-			}
-			i = 0;
+			dsp_cmx_pcm_used(freeslots, member->dsp->features.pcm_id,
+				member->dsp, nextm->dsp);
 			ii = member->dsp->features.pcm_slots;
-			while(i < ii) {
-				if (freeslots[i])
-					break;
-				i++;
-			}
-			if (i == ii) {
+			i = dsp_cmx_pcm_find(freeslots, 0, ii);
+			if (i < 0) {
 				if (dsp_debug & DEBUG_DSP_CMX)
 					printk(KERN_DEBUG "%s no slot available for %s & %s\n", __FUNCTION__,
 						member->dsp->inst.name, nextm->dsp->inst.name);
 				/* no more slots available */
+				noslot = 1;
 				goto conf_software;
 			}
 			/* assign free slot */
@@ -664,6 +721,7 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 				nextm->dsp->pcm_slot_rx, nextm->dsp->pcm_bank_rx);
 			conf->hardware = 1;
 			conf->software = 0;
+			cmx_hw_xconnect++;
 			return;
 		/* if members have one bank (or on the same chip) */
 		} else {
@@ -688,44 +746,17 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 				return;
 			}
 			/* find two new slot */
-			memset(freeslots, 1, sizeof(freeslots));
-			list_for_each_entry(dsp, &dsp_obj.ilist, list) {
-				if (dsp!=member->dsp
-				 && dsp!=nextm->dsp
-				 && member->dsp->features.pcm_id==dsp->features.pcm_id) {
-					if (dsp->pcm_slot_rx>=0
-					 && dsp->pcm_slot_rx<sizeof(freeslots))
-						freeslots[dsp->pcm_slot_tx] = 0;
-					if (dsp->pcm_slot_tx>=0
-					 && dsp->pcm_slot_tx<sizeof(freeslots))
-						freeslots[dsp->pcm_slot_rx] = 0;
-				}
-			}
-			i1 = 0;
+			dsp_cmx_pcm_used(freeslots, member->dsp->features.pcm_id,
+				member->dsp, nextm->dsp);
 			ii = member->dsp->features.pcm_slots;
-			while(i1 < ii) {
-				if (freeslots[i1])
-					break;
-				i1++;
-			}
-			if (i1 == ii) {
-				if (dsp_debug & DEBUG_DSP_CMX)
-					printk(KERN_DEBUG "%s no slot available for %s & %s\n", __FUNCTION__,
-						member->dsp->inst.name, nextm->dsp->inst.name);
-				/* no more slots available */
-				goto conf_software;
-			}
-			i2 = i1+1;
-			while(i2 < ii) {
-				if (freeslots[i2])
-					break;
-				i2++;
-			}
-			if (i2 == ii) {
+			i1 = dsp_cmx_pcm_find(freeslots, 0, ii);
+			i2 = (i1 < 0) ? -1 : dsp_cmx_pcm_find(freeslots, i1 + 1, ii);
+			if (i2 < 0) {
 				if (dsp_debug & DEBUG_DSP_CMX)
 					printk(KERN_DEBUG "%s no slot available for %s & %s\n", __FUNCTION__,
 						member->dsp->inst.name, nextm->dsp->inst.name);
 				/* no more slots available */
+				noslot = 1;
 				goto conf_software;
 			}
 			/* assign free slots */
@@ -745,6 +776,7 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 			dsp_cmx_hw_message(nextm->dsp, HW_PCM_CONN, nextm->dsp->pcm_slot_tx, nextm->dsp->pcm_bank_tx, nextm->dsp->pcm_slot_rx, nextm->dsp->pcm_bank_rx);
 			conf->hardware = 1;
 			conf->software = 0;
+			cmx_hw_xconnect++;
 			return;
 		}
 	}
@@ -774,35 +806,18 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 			if (member->dsp->hfc_conf == current_conf) {
 				continue;
 			}
-			/* get a free timeslot first */
-			memset(freeslots, 1, sizeof(freeslots));
-			list_for_each_entry(dsp, &dsp_obj.ilist, list) {
-				/* not checking current member, because
-				 * slot will be overwritten.
-				 */
-				if (dsp!=member->dsp
-				/* dsp must be on the same PCM */
-				 && member->dsp->features.pcm_id==dsp->features.pcm_id) {
-					/* dsp must be on a slot */
-					if (dsp->pcm_slot_tx>=0
-					 && dsp->pcm_slot_tx<sizeof(freeslots))
-						freeslots[dsp->pcm_slot_tx] = 0;
-					if (dsp->pcm_slot_rx>=0
-					 && dsp->pcm_slot_rx<sizeof(freeslots))
-						freeslots[dsp->pcm_slot_rx] = 0;
-				}
-			}
-			i = 0;
-			ii = member->dsp->features.pcm_slots;
-			while(i < ii) {
-				if (freeslots[i])
-					break;
-				i++;
-			}
-			if (i == ii) {
+			/* get a free timeslot first, not checking current
+			 * member, because slot will be overwritten.
+			 */
+			dsp_cmx_pcm_used(freeslots, member->dsp->features.pcm_id,
+				member->dsp, NULL);
+			i = dsp_cmx_pcm_find(freeslots, 0,
+				member->dsp->features.pcm_slots);
+			if (i < 0) {
 				/* no more slots available */
 				if (dsp_debug & DEBUG_DSP_CMX)
 					printk(KERN_DEBUG "%s conference %d cannot be formed, because no slot free\n", __FUNCTION__, conf->id);
+				noslot = 1;
 				goto conf_software;
 			}
 			if (dsp_debug & DEBUG_DSP_CMX)
@@ -815,6 +830,7 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 			member->dsp->hfc_conf = current_conf;
 			dsp_cmx_hw_message(member->dsp, HW_PCM_CONN, i, 2, i, 2);
 			dsp_cmx_hw_message(member->dsp, HW_CONF_JOIN, current_conf, 0, 0, 0);
+			cmx_hw_conf++;
 		}
 		return;
 	}
@@ -842,6 +858,7 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 		/* no more conferences available */
 		if (dsp_debug & DEBUG_DSP_CMX)
 			printk(KERN_DEBUG "%s conference %d cannot be formed, because no conference number free\n", __FUNCTION__, conf->id);
+		noslot = 1;
 		goto conf_software;
 	}
 	/* join all members */
@@ -849,6 +866,34 @@ dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
 	goto join_members;
 }
 
+/*
+ * A conference, which is mixed in software because no PCM slot or HFC
+ * conference unit was free, is checked again after slots or units were
+ * released, so it gets the hardware as soon as possible.
+ */
+void
+dsp_cmx_hardware(conference_t *conf, dsp_t *dsp)
+{
+	conference_t	*wconf;
+	u_long		released = cmx_released;
+
+	dsp_cmx_hw_update(conf, dsp);
+	if (released == cmx_released)
+		return;
+	list_for_each_entry(wconf, &Conf_list, list) {
+		if (!wconf->hw_wait || wconf == conf
+		 || list_empty(&wconf->mlist))
+			continue;
+		if (dsp_debug & DEBUG_DSP_CMX)
+			printk(KERN_DEBUG "%s resources released, checking waiting conference %d\n",
+				__FUNCTION__, wconf->id);
+		dsp_cmx_hw_update(wconf, NULL);
+		/* hw_wait is also 0 if it stays in software for other reasons */
+		if (wconf->hardware)
+			cmx_rebalanced++;
+	}
+}
+
 
 /*
  * conf_id != 0: join or change conference
@@ -2152,11 +2152,13 @@ static int faxl3_init(void)
 	faxl3fsm.event_count = FAXL3_EVENT_COUNT;
 	faxl3fsm.strEvent = strfaxl3Event;
 	faxl3fsm.strState = strfaxl3State;
+	faxl3fsm.name = "faxl3";
 	mISDN_FsmNew(&faxl3fsm, FaxL3FnList, FAXL3_FN_COUNT);
 	modfsm.state_count = MOD_STATE_COUNT;
 	modfsm.event_count = MOD_EVENT_COUNT;
 	modfsm.strEvent = strmodEvent;
 	modfsm.strState = strmodState;
+	modfsm.name = "faxl3_mod";
 	mISDN_FsmNew(&modfsm, ModFnList, MOD_FN_COUNT);
 	return(err);
 }
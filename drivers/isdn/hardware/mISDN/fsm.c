@@ -20,15 +20,31 @@
 
 #define FSM_TIMER_DEBUG 0
 
+#ifdef MISDN_FSM_STATS
+static LIST_HEAD(fsm_list);
+static DEFINE_SPINLOCK(fsm_lock);
+#endif
+
 void
 mISDN_FsmNew(struct Fsm *fsm,
        struct FsmNode *fnlist, int fncount)
 {
 	int i;
+#ifdef MISDN_FSM_STATS
+	u_long flags;
+#endif
 
 	fsm->jumpmatrix = (FSMFNPTR *)
 		kmalloc(sizeof (FSMFNPTR) * fsm->state_count * fsm->event_count, GFP_KERNEL);
 	memset(fsm->jumpmatrix, 0, sizeof (FSMFNPTR) * fsm->state_count * fsm->event_count);
+#ifdef MISDN_FSM_STATS
+	fsm->hits = kmalloc(sizeof(u_int) * fsm->state_count * fsm->event_count, GFP_KERNEL);
+	if (fsm->hits)
+		memset(fsm->hits, 0, sizeof(u_int) * fsm->state_count * fsm->event_count);
+	spin_lock_irqsave(&fsm_lock, flags);
+	list_add_tail(&fsm->list, &fsm_list);
+	spin_unlock_irqrestore(&fsm_lock, flags);
+#endif
 
 	for (i = 0; i < fncount; i++) 
 		if ((fnlist[i].state>=fsm->state_count) || (fnlist[i].event>=fsm->event_count)) {
@@ -36,27 +52,44 @@ mISDN_FsmNew(struct Fsm *fsm,
 				i,(long)fnlist[i].state,(long)fsm->state_count,
 				(long)fnlist[i].event,(long)fsm->event_count);
 		} else		
-			fsm->jumpmatrix[fsm->state_count * fnlist[i].event +
-				fnlist[i].state] = (FSMFNPTR) fnlist[i].routine;
+			fsm->jumpmatrix[fsm->event_count * fnlist[i].state +
+				fnlist[i].event] = (FSMFNPTR) fnlist[i].routine;
 }
 
 void
 mISDN_FsmFree(struct Fsm *fsm)
 {
+#ifdef MISDN_FSM_STATS
+	u_long flags;
+
+	spin_lock_irqsave(&fsm_lock, flags);
+	list_del(&fsm->list);
+	spin_unlock_irqrestore(&fsm_lock, flags);
+	kfree(fsm->hits);
+	fsm->hits = NULL;
+#endif
 	kfree((void *) fsm->jumpmatrix);
 }
 
 int
 mISDN_FsmEvent(struct FsmInst *fi, int event, void *arg)
 {
+	struct Fsm *fsm = fi->fsm;
+	u_int idx;
 	FSMFNPTR r;
 
-	if ((fi->state>=fi->fsm->state_count) || (event >= fi->fsm->event_count)) {
+	if (unlikely((u_int)fi->state >= (u_int)fsm->state_count ||
+		(u_int)event >= (u_int)fsm->event_count)) {
 		printk(KERN_ERR "mISDN_FsmEvent Error st(%ld/%ld) ev(%d/%ld)\n",
-			(long)fi->state,(long)fi->fsm->state_count,event,(long)fi->fsm->event_count);
+			(long)fi->state,(long)fsm->state_count,event,(long)fsm->event_count);
 		return(1);
 	}
-	r = fi->fsm->jumpmatrix[fi->fsm->state_count * event + fi->state];
+	idx = fsm->event_count * fi->state + event;
+#ifdef MISDN_FSM_STATS
+	if (fsm->hits)
+		fsm->hits[idx]++;
+#endif
+	r = fsm->jumpmatrix[idx];
 	if (r) {
 		if (fi->debug)
 			fi->printdebug(fi, "State %s Event %s",
@@ -161,6 +194,59 @@ mISDN_FsmRestartTimer(struct FsmTimer *ft,
 	add_timer(&ft->tl);
 }
 
+#ifdef MISDN_FSM_STATS
+/*
+ * one line per transition which was hit at least once,
+ * events without action are marked as unhandled
+ */
+ssize_t
+mISDN_FsmShowStats(char *buf, size_t size)
+{
+	struct Fsm *fsm;
+	char *p = buf;
+	int st, ev, idx;
+	u_long flags;
+
+	spin_lock_irqsave(&fsm_lock, flags);
+	list_for_each_entry(fsm, &fsm_list, list) {
+		if (!fsm->hits)
+			continue;
+		for (st = 0; st < fsm->state_count; st++) {
+			for (ev = 0; ev < fsm->event_count; ev++) {
+				idx = fsm->event_count * st + ev;
+				if (!fsm->hits[idx])
+					continue;
+				if ((p - buf) + 128 > size)
+					goto out;
+				p += sprintf(p, "%s %s %s %u%s\n",
+					fsm->name ? fsm->name : "fsm",
+					fsm->strState[st], fsm->strEvent[ev],
+					fsm->hits[idx],
+					fsm->jumpmatrix[idx] ? "" : " unhandled");
+			}
+		}
+	}
+out:
+	spin_unlock_irqrestore(&fsm_lock, flags);
+	return(p - buf);
+}
+
+void
+mISDN_FsmResetStats(void)
+{
+	struct Fsm *fsm;
+	u_long flags;
+
+	spin_lock_irqsave(&fsm_lock, flags);
+	list_for_each_entry(fsm, &fsm_list, list) {
+		if (fsm->hits)
+			memset(fsm->hits, 0,
+				sizeof(u_int) * fsm->state_count * fsm->event_count);
+	}
+	spin_unlock_irqrestore(&fsm_lock, flags);
+}
+#endif
+
 EXPORT_SYMBOL(mISDN_FsmNew);
 EXPORT_SYMBOL(mISDN_FsmFree);
 EXPORT_SYMBOL(mISDN_FsmEvent);
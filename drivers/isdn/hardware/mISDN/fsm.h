@@ -15,10 +15,19 @@ struct FsmInst;
 
 typedef void (* FSMFNPTR)(struct FsmInst *, int, void *);
 
+/*
+ * jumpmatrix is laid out state-major, all events of one state are
+ * adjacent: jumpmatrix[event_count * state + event]
+ */
 struct Fsm {
 	FSMFNPTR *jumpmatrix;
 	int state_count, event_count;
 	char **strEvent, **strState;
+	char *name;
+#ifdef MISDN_FSM_STATS
+	struct list_head list;
+	u_int *hits;
+#endif
 };
 
 struct FsmInst {
@@ -50,5 +59,9 @@ extern void mISDN_FsmInitTimer(struct FsmInst *, struct FsmTimer *);
 extern int mISDN_FsmAddTimer(struct FsmTimer *, int, int, void *, int);
 extern void mISDN_FsmRestartTimer(struct FsmTimer *, int, int, void *, int);
 extern void mISDN_FsmDelTimer(struct FsmTimer *, int);
+#ifdef MISDN_FSM_STATS
+extern ssize_t mISDN_FsmShowStats(char *, size_t);
+extern void mISDN_FsmResetStats(void);
+#endif
 
 #endif
@@ -396,6 +396,51 @@ mISDN_init_instance(mISDNinstance_t *inst, mISDNobject_t *obj, void *data, if_fu
 	inst->function = function;
 }
 
+/*
+ * a PH_DATA_CHAIN_IND skb holds the first frame, the other frames are
+ * linked on its frag_list; put every frame on q as a skb of its own
+ */
+int
+mISDN_unchain_skb(struct sk_buff *skb, struct sk_buff_head *q)
+{
+	struct sk_buff	*fskb, *next;
+	int		cnt = 1;
+
+	fskb = skb_shinfo(skb)->frag_list;
+	skb_shinfo(skb)->frag_list = NULL;
+	skb->len -= skb->data_len;
+	skb->data_len = 0;
+	__skb_queue_tail(q, skb);
+	while (fskb) {
+		next = fskb->next;
+		fskb->next = NULL;
+		skb->truesize -= fskb->truesize;
+		__skb_queue_tail(q, fskb);
+		fskb = next;
+		cnt++;
+	}
+	return(cnt);
+}
+
+/* same as above, but the frames are copied and the chain is not touched */
+int
+mISDN_copy_chain(struct sk_buff *skb, struct sk_buff_head *q)
+{
+	struct sk_buff	*fskb = skb, *nskb;
+	int		len, cnt = 0;
+
+	while (fskb) {
+		len = (fskb == skb) ? skb_headlen(skb) : fskb->len;
+		if (!(nskb = alloc_stack_skb(len, skb_headroom(fskb))))
+			break;
+		memcpy(skb_put(nskb, len), fskb->data, len);
+		__skb_queue_tail(q, nskb);
+		cnt++;
+		fskb = (fskb == skb) ? skb_shinfo(skb)->frag_list : fskb->next;
+	}
+	return(cnt);
+}
+
 EXPORT_SYMBOL(mISDN_set_dchannel_pid);
 EXPORT_SYMBOL(mISDN_get_lowlayer);
 EXPORT_SYMBOL(mISDN_get_up_layer);
@@ -406,6 +451,8 @@ EXPORT_SYMBOL(mISDN_HasProtocol);
 EXPORT_SYMBOL(mISDN_SetHandledPID);
 EXPORT_SYMBOL(mISDN_RemoveUsedPID);
 EXPORT_SYMBOL(mISDN_init_instance);
+EXPORT_SYMBOL(mISDN_unchain_skb);
+EXPORT_SYMBOL(mISDN_copy_chain);
 // EXPORT_SYMBOL(mISDN_SetIF);
 // EXPORT_SYMBOL(mISDN_ConnectIF);
 // EXPORT_SYMBOL(mISDN_DisConnectIF);
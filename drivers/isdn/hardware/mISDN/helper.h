@@ -144,6 +144,16 @@ extern void	mISDN_RemoveUsedPID(mISDN_pid_t *, mISDN_pid_t *);
  */ 
 extern void	mISDN_init_instance(mISDNinstance_t *, mISDNobject_t *, void *, if_func_t *);
 
+/*
+ * mISDN_unchain_skb(struct sk_buff *skb, struct sk_buff_head *q)
+ * mISDN_copy_chain(struct sk_buff *skb, struct sk_buff_head *q)
+ *
+ * split the frames of a PH_DATA_CHAIN_IND <skb> onto queue <q>,
+ * mISDN_copy_chain() leaves <skb> untouched; both return the frame count
+ */
+extern int	mISDN_unchain_skb(struct sk_buff *, struct sk_buff_head *);
+extern int	mISDN_copy_chain(struct sk_buff *, struct sk_buff_head *);
+
 /* returns the member count of a list */
 static inline int
 count_list_member(struct list_head *head)
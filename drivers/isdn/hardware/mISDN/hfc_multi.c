@@ -44,6 +44,7 @@
 	Bit 17	= Use 128 timeslots instead of anything else
 	Bit 18	= Use crystal clock for PCM and E1, for autarc clocking.
 	Bit 19	= Send the Watchdog a Signal (Dual E1 with Watchdog)
+	Bit 20	= Use 8 bit instead of 32 bit FIFO data access.
 
  * protocol:
 	NOTE: Must be given for all ports, not for the number of cards.
@@ -92,6 +93,8 @@
 
 /* debug using register map (never use this, it will flood your system log) */
 //#define HFC_REGISTER_MAP
+/* host builds without a card: register model in hfc_multi.h, needs PCIMEM */
+//#define HFC_REGISTER_SIM
 
 #include <linux/interrupt.h>
 #include <linux/sched.h>
@@ -165,8 +168,9 @@ static int nt_t1_count[] = { 480, 240, 120, 60, 30, 15, 8, 4 };
 #define CLKDEL_NT	0x0c	/* CLKDEL in NT mode (0x60 MUST not be included!) */
 static u_char silence =	0xff;	/* silence by LAW */
 
-/* enable 32 bit fifo access (PC usage) */
-#define FIFO_32BIT_ACCESS
+/* 32 bit fifo access (PC usage) is enabled for each chip by
+ * HFC_CHIP_FIFO32, unless disabled by type bit 20
+ */
 
 #define VENDOR_CCD "Cologne Chip AG"
 #define CCAG_VID 0x1397      // Cologne Chip Vendor ID
@@ -290,6 +294,8 @@ static int layermask[MAX_PORTS];
 static int debug;
 static int poll;
 static int timer;
+static u_int irq_poll;		/* FIFO IRQs per timer IRQ to start polling, 0=off */
+static u_int poll_budget = 16;	/* channels per run of the poll tasklet */
 
 
 #ifdef MODULE
@@ -301,6 +307,8 @@ MODULE_LICENSE("GPL");
 MODULE_PARM(debug, "1i");
 MODULE_PARM(poll, "1i");
 MODULE_PARM(timer, "1i");
+MODULE_PARM(irq_poll, "1i");
+MODULE_PARM(poll_budget, "1i");
 #define MODULE_PARM_T   "1-128i"
 MODULE_PARM(protocol, MODULE_PARM_T);
 MODULE_PARM(layermask, MODULE_PARM_T);
@@ -310,6 +318,8 @@ MODULE_PARM(pcm, MODULE_PARM_T);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 module_param(poll, uint, S_IRUGO | S_IWUSR);
 module_param(timer, uint, S_IRUGO | S_IWUSR);
+module_param(irq_poll, uint, S_IRUGO | S_IWUSR);
+module_param(poll_budget, uint, S_IRUGO | S_IWUSR);
 
 
 #ifdef OLD_MODULE_PARAM_ARRAY
@@ -1350,19 +1360,20 @@ void write_fifo_data(hfc_multi_t *hc,BYTE *dest,int len)
 
 	remain = len;
 
-#ifdef FIFO_32BIT_ACCESS
-	for (i = 0; i < len/4; i++) {
-		HFC_outl_(hc, A_FIFO_DATA0, *((DWORD *)dest));
-		remain -= 4;
-		dest += 4;
+	if (test_bit(HFC_CHIP_FIFO32, &hc->chip)) {
+		for (i = 0; i < len/4; i++) {
+			HFC_outl_(hc, A_FIFO_DATA0, *((u32 *)dest));
+			remain -= 4;
+			dest += 4;
+		}
 	}
-#endif
-
 #ifdef FIFO_16BIT_ACCESS
-	for (i = 0; i < len/2; i++) {
-		HFC_outw_(hc, A_FIFO_DATA0, *((WORD *)dest));
-		remain -= 2;
-		dest += 2;
+	else {
+		for (i = 0; i < len/2; i++) {
+			HFC_outw_(hc, A_FIFO_DATA0, *((WORD *)dest));
+			remain -= 2;
+			dest += 2;
+		}
 	}
 #endif
 
@@ -1384,19 +1395,20 @@ write_fifo_data(hfc_multi_t *hc, BYTE *dest, int len)
 	remain = len;
 	HFC_set(hc, A_FIFO_DATA0);
 
-#ifdef FIFO_32BIT_ACCESS
-	for (i = 0; i < len/4; i++) {
-		HFC_putl(hc, *((DWORD *)dest));
-		remain -= 4;
-		dest += 4;
+	if (test_bit(HFC_CHIP_FIFO32, &hc->chip)) {
+		for (i = 0; i < len/4; i++) {
+			HFC_putl(hc, *((u32 *)dest));
+			remain -= 4;
+			dest += 4;
+		}
 	}
-#endif
-
 #ifdef FIFO_16BIT_ACCESS
-	for(i = 0; i < len/2; i++) {
-		HFC_putw(hc, *((WORD *)dest));
-		remain -= 2;
-		dest += 2;
+	else {
+		for(i = 0; i < len/2; i++) {
+			HFC_putw(hc, *((WORD *)dest));
+			remain -= 2;
+			dest += 2;
+		}
 	}
 #endif
 
@@ -1405,6 +1417,74 @@ write_fifo_data(hfc_multi_t *hc, BYTE *dest, int len)
 }
 #endif
 
+/*
+ * read both F-counters (A_F12) or both Z-counters (A_Z12) of the
+ * selected fifo with one access, until the value is stable.
+ * only the counter changed by the chip may change, so we need two
+ * accesses instead of three.
+ * without HFC_CHIP_FIFO32 (PLX bridge, type bit 20) the counters are read
+ * one by one, only the counter changed by the chip (F1/Z1 for rx,
+ * F2/Z2 for tx) is read again.
+ */
+static inline u_int
+hfcmulti_read_f12(hfc_multi_t *hc, int rx)
+{
+	u_int	f12, temp;
+
+	if (!test_bit(HFC_CHIP_FIFO32, &hc->chip)) {
+		u_char	f, reg = rx ? A_F1 : A_F2;
+
+		f = HFC_inb_(hc, reg);
+		while (f != (temp = HFC_inb_(hc, reg))) {
+			if (debug & DEBUG_HFCMULTI_FIFO)
+				printk(KERN_DEBUG "%s: reread %s because %d!=%d\n",
+					__FUNCTION__, rx ? "f1" : "f2", temp, f);
+			f = temp; /* repeat until F is equal */
+		}
+		if (rx)
+			return(f | (HFC_inb_(hc, A_F2) << 8));
+		return(HFC_inb_(hc, A_F1) | (f << 8));
+	}
+	f12 = HFC_inw_(hc, A_F12);
+	while (f12 != (temp = HFC_inw_(hc, A_F12))) {
+		if (debug & DEBUG_HFCMULTI_FIFO)
+			printk(KERN_DEBUG "%s: reread f12 because %04x!=%04x\n",
+				__FUNCTION__, temp, f12);
+		f12 = temp; /* repeat until F1/F2 is equal */
+	}
+	return(f12);
+}
+
+static inline u_int
+hfcmulti_read_z12(hfc_multi_t *hc, int rx)
+{
+	u_int	z12, temp;
+
+	if (!test_bit(HFC_CHIP_FIFO32, &hc->chip)) {
+		u_int	z;
+		u_char	reg = rx ? A_Z1 : A_Z2;
+
+		z = HFC_inw_(hc, reg);
+		while (z != (temp = HFC_inw_(hc, reg))) {
+			if (debug & DEBUG_HFCMULTI_FIFO)
+				printk(KERN_DEBUG "%s: reread %s because %d!=%d\n",
+					__FUNCTION__, rx ? "z1" : "z2", temp, z);
+			z = temp; /* repeat until Z is equal */
+		}
+		if (rx)
+			return(z | (HFC_inw_(hc, A_Z2) << 16));
+		return(HFC_inw_(hc, A_Z1) | (z << 16));
+	}
+	z12 = HFC_inl_(hc, A_Z12);
+	while (z12 != (temp = HFC_inl_(hc, A_Z12))) {
+		if (debug & DEBUG_HFCMULTI_FIFO)
+			printk(KERN_DEBUG "%s: reread z12 because %08x!=%08x\n",
+				__FUNCTION__, temp, z12);
+		z12 = temp; /* repeat until Z1/Z2 is equal */
+	}
+	return(z12);
+}
+
 /*********************************/
 /* fill fifo as much as possible */
 /*********************************/
@@ -1412,15 +1492,13 @@ write_fifo_data(hfc_multi_t *hc, BYTE *dest, int len)
 static void
 hfcmulti_tx(hfc_multi_t *hc, int ch, channel_t *chan)
 {
-	int i, ii, temp, len;
+	int i, ii, len;
 	int Zspace, z1, z2;
 	int Fspace, f1, f2;
+	u_int z12, f12;
 	BYTE *d;
 	int txpending, slot_tx;
 
-	f1 = HFC_inb_(hc, A_F1);
-	f2 = HFC_inb_(hc, A_F2);
-	//printk(KERN_DEBUG "txf12:%x %x\n",f1,f2);
 	/* get skb, fifo & mode */
 	
 	txpending = hc->chan[ch].txpending;
@@ -1444,17 +1522,13 @@ hfcmulti_tx(hfc_multi_t *hc, int ch, channel_t *chan)
 		HFC_wait_(hc);
 		HFC_outb(hc, A_SUBCH_CFG, 0);
 		txpending = 1;
+		hc->chan[ch].loop = HFC_LOOP_NONE;
 	}
 next_frame:
 	if (test_bit(FLG_HDLC, &chan->Flags)) {
-		f1 = HFC_inb_(hc, A_F1);
-		f2 = HFC_inb_(hc, A_F2);
-		while (f2 != (temp = HFC_inb_(hc, A_F2))) {
-			if (debug & DEBUG_HFCMULTI_FIFO)
-				printk(KERN_DEBUG "%s: reread f2 because %d!=%d\n",
-					__FUNCTION__, temp, f2);
-			f2 = temp; /* repeat until F2 is equal */
-		}
+		f12 = hfcmulti_read_f12(hc, 0);
+		f1 = f12 & 0xff;
+		f2 = f12 >> 8;
 		Fspace = f2 - f1 - 1;
 		if (Fspace < 0)
 			Fspace += hc->Flen;
@@ -1478,14 +1552,9 @@ next_frame:
 		if (Fspace == 0)
 			return;
 	}
-	z1 = HFC_inw_(hc, A_Z1) - hc->Zmin;
-	z2 = HFC_inw_(hc, A_Z2) - hc->Zmin;
-	while (z2 != (temp = (HFC_inw_(hc, A_Z2) - hc->Zmin))) {
-		if (debug & DEBUG_HFCMULTI_FIFO)
-			printk(KERN_DEBUG "%s: reread z2 because %d!=%d\n",
-				__FUNCTION__, temp, z2);
-		z2 = temp; /* repeat unti Z2 is equal */
-	}
+	z12 = hfcmulti_read_z12(hc, 0);
+	z1 = (z12 & 0xffff) - hc->Zmin;
+	z2 = (z12 >> 16) - hc->Zmin;
 	Zspace = z2 - z1 - 1;
 	if (Zspace < 0)
 		Zspace += hc->Zlen;
@@ -1528,6 +1597,7 @@ next_frame:
 		HFC_wait_(hc);
 	}
 	txpending = hc->chan[ch].txpending = 1;
+	hc->chan[ch].loop = HFC_LOOP_NONE;
 
 	/* show activity */
 	hc->activity[hc->chan[ch].port] = 1;
@@ -1602,19 +1672,20 @@ void read_fifo_data(hfc_multi_t *hc, BYTE *dest, int len)
 
 	remain = len;
 
-#ifdef FIFO_32BIT_ACCESS
-	for(i = 0; i < len/4; i++) {
-		*((DWORD *)dest) = HFC_inl_(hc, A_FIFO_DATA0);
-		remain -= 4;
-		dest += 4;
+	if (test_bit(HFC_CHIP_FIFO32, &hc->chip)) {
+		for(i = 0; i < len/4; i++) {
+			*((u32 *)dest) = HFC_inl_(hc, A_FIFO_DATA0);
+			remain -= 4;
+			dest += 4;
+		}
 	}
-#endif
-
 #ifdef FIFO_16BIT_ACCESS
-	for(i = 0; i < len/2; i++) {
-		*((WORD *)dest) = HFC_inw_(hc, A_FIFO_DATA0);
-		remain -= 2;
-		dest += 2;
+	else {
+		for(i = 0; i < len/2; i++) {
+			*((WORD *)dest) = HFC_inw_(hc, A_FIFO_DATA0);
+			remain -= 2;
+			dest += 2;
+		}
 	}
 #endif
 
@@ -1635,19 +1706,20 @@ void read_fifo_data(hfc_multi_t *hc, BYTE *dest, int len)
 	remain = len;
 	HFC_set(hc, A_FIFO_DATA0);
 
-#ifdef FIFO_32BIT_ACCESS
-	for(i = 0; i < len/4; i++) {
-		*((DWORD *)dest) = HFC_getl(hc);
-		remain -= 4;
-		dest += 4;
+	if (test_bit(HFC_CHIP_FIFO32, &hc->chip)) {
+		for(i = 0; i < len/4; i++) {
+			*((u32 *)dest) = HFC_getl(hc);
+			remain -= 4;
+			dest += 4;
+		}
 	}
-#endif
-
 #ifdef FIFO_16BIT_ACCESS
-	for(i = 0; i < len/2; i++) {
-		*((WORD *)dest) = HFC_getw(hc);
-		remain -= 2;
-		dest += 2;
+	else {
+		for(i = 0; i < len/2; i++) {
+			*((WORD *)dest) = HFC_getw(hc);
+			remain -= 2;
+			dest += 2;
+		}
 	}
 #endif
 
@@ -1661,8 +1733,9 @@ static void
 hfcmulti_rx(hfc_multi_t *hc, int ch, channel_t *chan)
 {
 	int temp;
-	int Zsize, z1, z2 = 0; /* = 0, to make GCC happy */
+	int Zsize, z1, z2;
 	int f1 = 0, f2 = 0; /* = 0, to make GCC happy */
+	u_int z12, f12;
 	struct sk_buff *skb;
 
 	/* lets see how much data we received */
@@ -1674,23 +1747,14 @@ hfcmulti_rx(hfc_multi_t *hc, int ch, channel_t *chan)
 	HFC_wait_(hc);
 next_frame:
 	if (test_bit(FLG_HDLC, &chan->Flags)) {
-		f1 = HFC_inb_(hc, A_F1);
-		while (f1 != (temp = HFC_inb_(hc, A_F1))) {
-			if (debug & DEBUG_HFCMULTI_FIFO)
-				printk(KERN_DEBUG "%s: reread f1 because %d!=%d\n", __FUNCTION__, temp, f1);
-			f1 = temp; /* repeat until F1 is equal */
-		}
-		f2 = HFC_inb_(hc, A_F2);
+		f12 = hfcmulti_read_f12(hc, 1);
+		f1 = f12 & 0xff;
+		f2 = f12 >> 8;
 	}
 	//if(f1!=f2) printk(KERN_DEBUG "got a chan:%d framef12:%x %x!!!!\n",ch,f1,f2);
-	//printk(KERN_DEBUG "got a chan:%d framef12:%x %x!!!!\n",ch,f1,f2);
-	z1 = HFC_inw_(hc, A_Z1) - hc->Zmin;
-	while(z1 != (temp = (HFC_inw_(hc, A_Z1) - hc->Zmin))) {
-		if (debug & DEBUG_HFCMULTI_FIFO)
-			printk(KERN_DEBUG "%s: reread z2 because %d!=%d\n", __FUNCTION__, temp, z2);
-		z1 = temp; /* repeat until Z1 is equal */
-	}
-	z2 = HFC_inw_(hc, A_Z2) - hc->Zmin;
+	z12 = hfcmulti_read_z12(hc, 1);
+	z1 = (z12 & 0xffff) - hc->Zmin;
+	z2 = (z12 >> 16) - hc->Zmin;
 	Zsize = z1 - z2;
 	if (test_bit(FLG_HDLC, &chan->Flags) && f1 != f2) /* complete hdlc frame */
 		Zsize++;
@@ -1774,7 +1838,7 @@ next_frame:
 					printk("%02x ", skb->data[temp++]);
 				printk("\n");
 			}
-			queue_ch_frame(chan, INDICATION, MISDN_ID_ANY, skb);
+			queue_ch_dframe(chan, skb);
 			goto next_frame;
 		}
 		/* there is an incomplete frame */
@@ -1819,19 +1883,99 @@ static void signal_state_up(channel_t *dch, int dinfo, char *msg)
 		dev_kfree_skb(skb);
 }
 
+/*
+ * poll tasklet, services the channels while FIFO IRQs are masked
+ * not more than poll_budget channels are serviced in one run, the
+ * rest is done in the next run
+ */
+static void
+hfcmulti_poll(u_long data)
+{
+	hfc_multi_t	*hc = (hfc_multi_t *)data;
+	channel_t	*chan;
+	u_long		flags;
+	int		ch, cnt = 0;
+
+	spin_lock_irqsave(&hc->lock, flags);
+	hc->irqstat.poll_runs++;
+	ch = hc->poll_next;
+	while(ch < 32) {
+		if (poll_budget && cnt >= poll_budget)
+			break;
+		chan = hc->chan[ch].ch;
+		if (chan && hc->created[hc->chan[ch].port]) {
+			hfcmulti_tx(hc, ch, chan);
+			hfcmulti_rx(hc, ch, chan);
+			flush_ch_frames(chan);
+			cnt++;
+		}
+		ch++;
+	}
+	hc->irqstat.poll_chan += cnt;
+	if (ch < 32) {
+		hc->poll_next = ch;
+		hc->irqstat.poll_budget++;
+		tasklet_schedule(&hc->poll_tasklet);
+	} else
+		hc->poll_next = 0;
+	spin_unlock_irqrestore(&hc->lock, flags);
+}
+
+/*
+ * called with every timer IRQ
+ * if more than irq_poll FIFO IRQs came in since the last timer IRQ, FIFO
+ * IRQs are masked and the channels are serviced by the poll tasklet, which
+ * is scheduled by the timer IRQ. After POLL_HOLD timer IRQs the FIFO IRQs
+ * are enabled again, if the load is still high, we go back to polling with
+ * the next timer IRQ.
+ */
+#define POLL_HOLD	8
+
+static void
+hfcmulti_irq_coalesce(hfc_multi_t *hc)
+{
+	if (hc->polling) {
+		if (irq_poll && --hc->poll_hold > 0)
+			return;
+		hc->polling = 0;
+		hc->hw.r_irq_ctrl |= V_FIFO_IRQ;
+		HFC_outb(hc, R_IRQ_CTRL, hc->hw.r_irq_ctrl);
+		hc->irqstat.poll_exit++;
+		if (debug & DEBUG_HFCMULTI_INIT)
+			printk(KERN_DEBUG "%s: (id=%d) FIFO IRQs enabled\n",
+				__FUNCTION__, hc->id);
+	} else if (irq_poll && hc->fifo_irqs > irq_poll) {
+		hc->polling = 1;
+		hc->poll_hold = POLL_HOLD;
+		hc->poll_next = 0;
+		hc->hw.r_irq_ctrl &= ~((u_char)V_FIFO_IRQ);
+		HFC_outb(hc, R_IRQ_CTRL, hc->hw.r_irq_ctrl);
+		hc->irqstat.poll_enter++;
+		if (debug & DEBUG_HFCMULTI_INIT)
+			printk(KERN_DEBUG "%s: (id=%d) %d FIFO IRQs, polling\n",
+				__FUNCTION__, hc->id, hc->fifo_irqs);
+	}
+	hc->fifo_irqs = 0;
+}
+
 static inline void
 handle_timer_irq(hfc_multi_t *hc)
 {
 	int		ch, temp;
 	channel_t	*chan;
 
+	hc->irqstat.timer++;
+	hfcmulti_irq_coalesce(hc);
 	ch = 0;
 	while(ch < 32) {
 		chan = hc->chan[ch].ch;
 		if (chan && hc->created[hc->chan[ch].port]) {
-			hfcmulti_tx(hc, ch, chan);
-			/* fifo is started when switching to rx-fifo */
-			hfcmulti_rx(hc, ch, chan);
+			if (!hc->polling) {
+				hfcmulti_tx(hc, ch, chan);
+				/* fifo is started when switching to rx-fifo */
+				hfcmulti_rx(hc, ch, chan);
+				flush_ch_frames(chan);
+			}
 			if (test_bit(FLG_DCHANNEL, &chan->Flags) &&
 				hc->chan[ch].nt_timer > -1) {
 				if (!(--hc->chan[ch].nt_timer)) {
@@ -1844,6 +1988,8 @@ handle_timer_irq(hfc_multi_t *hc)
 		}
 		ch++;
 	}
+	if (hc->polling)
+		tasklet_schedule(&hc->poll_tasklet);
 	if (hc->type == 1 && hc->created[0]) {
 		chan = hc->chan[16].ch;
 		if (test_bit(HFC_CFG_REPORT_LOS, &hc->chan[16].cfg)) {
@@ -2084,6 +2230,10 @@ hfcmulti_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 				 
 	}
 	if (status & V_FR_IRQSTA) {
+		hc->fifo_irqs++;
+		hc->irqstat.fifo++;
+	}
+	if ((status & V_FR_IRQSTA) && !hc->polling) {
 		/* FIFO IRQ */
 		r_irq_oview = HFC_inb_(hc, R_IRQ_OVIEW);
 		//if(r_irq_oview) printk(KERN_DEBUG "OV:%x\n",r_irq_oview);
@@ -2121,6 +2271,7 @@ hfcmulti_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 						if (chan && hc->created[hc->chan[ch].port] &&
 							test_bit(FLG_ACTIVE, &chan->Flags)) {
 							hfcmulti_rx(hc, ch, chan);
+							flush_ch_frames(chan);
 							//printk(KERN_DEBUG "rxchan:%d\n",ch);
 						}
 					}
@@ -2172,6 +2323,7 @@ mode_hfcmulti(hfc_multi_t *hc, int ch, int protocol, int slot_tx, int bank_tx, i
 	if (debug & DEBUG_HFCMULTI_MODE)
 		printk(KERN_DEBUG "%s: channel %d protocol %x slot %d bank %d (TX) slot %d bank %d (RX)\n",
 			__FUNCTION__, ch, protocol, slot_tx, bank_tx, slot_rx, bank_rx);
+	hc->chan[ch].loop = HFC_LOOP_NONE;
 
 	if (oslot_tx>=0 && slot_tx!=oslot_tx) {
 		/* remove from slot */
@@ -2454,11 +2606,47 @@ hfcmulti_conf(hfc_multi_t *hc, int ch, int num)
 /***************************/
 /* set/disable sample loop */
 /***************************/
+
+/* returns the loop_tab index + 1 of the sample, HFC_LOOP_NONE if table is full */
+static int
+hfcmulti_loop_find(hfc_multi_t *hc, u_char *data, int len)
+{
+	hfcmulti_loop_t	*lp;
+	int		i;
+
+	for (i = 0; i < HFC_LOOP_TAB; i++) {
+		lp = &hc->loop_tab[i];
+		if (!lp->data) {
+			if (!(lp->data = kmalloc(len, GFP_ATOMIC)))
+				return(HFC_LOOP_NONE);
+			memcpy(lp->data, data, len);
+			lp->len = len;
+			return(i + 1);
+		}
+		if (lp->len == len && !memcmp(lp->data, data, len))
+			return(i + 1);
+	}
+	return(HFC_LOOP_NONE);
+}
+
+static void
+hfcmulti_loop_free(hfc_multi_t *hc)
+{
+	int	i;
+
+	for (i = 0; i < HFC_LOOP_TAB; i++) {
+		if (hc->loop_tab[i].data)
+			kfree(hc->loop_tab[i].data);
+		hc->loop_tab[i].data = NULL;
+	}
+}
+
 // NOTE: this function is experimental and therefore disabled
 static void
 hfcmulti_splloop(hfc_multi_t *hc, int ch, u_char *data, int len)
 {
 	channel_t *bch = hc->chan[ch].ch;
+	int loop;
 
 	/* flush pending TX data */
 	if (bch->next_skb) {
@@ -2472,6 +2660,14 @@ hfcmulti_splloop(hfc_multi_t *hc, int ch, u_char *data, int len)
 	if (len > hc->Zlen-1)
 		len = hc->Zlen-1;
 
+	/* nothing to do, if the FIFO already loops this sample or is silent */
+	loop = (len > 0) ? hfcmulti_loop_find(hc, data, len) : HFC_LOOP_OFF;
+	if (loop != HFC_LOOP_NONE && loop == hc->chan[ch].loop
+	 && hc->chan[ch].txpending == ((len > 0) ? 2 : 0)) {
+		hc->loop_avoided++;
+		return;
+	}
+
 	/* select fifo */
 	HFC_outb_(hc, R_FIFO, ch<<1);
 	HFC_wait_(hc);
@@ -2496,6 +2692,7 @@ hfcmulti_splloop(hfc_multi_t *hc, int ch, u_char *data, int len)
 			HFC_outb(hc, A_CON_HDLC, 0xc0 | 0x00 | V_HDLC_TRP | V_IFF);
 		}
 		hc->chan[ch].txpending = 0;
+		hc->chan[ch].loop = HFC_LOOP_OFF;
 		return;
 	}
 
@@ -2507,6 +2704,8 @@ hfcmulti_splloop(hfc_multi_t *hc, int ch, u_char *data, int len)
 //printk("len=%d %02x %02x %02x\n", len, data[0], data[1], data[2]);
 	/* write loop data */
 	write_fifo_data(hc,data,len);
+	hc->chan[ch].loop = loop;
+	hc->loop_uploads++;
 
 	udelay(500);
 	HFC_outb(hc, A_SUBCH_CFG, V_LOOP_FIFO);
@@ -2562,6 +2761,7 @@ handle_dmsg(channel_t *ch, struct sk_buff *skb)
 		ret = 0;
 		switch (hh->dinfo) {
 			case HW_RESET:
+				stop_ch_chain(ch);
 				/* start activation */
 				if (hc->type == 1) {
 					HFC_outb(hc, R_E1_WR_STA, V_E1_LD_STA | 0);
@@ -2615,6 +2815,12 @@ handle_dmsg(channel_t *ch, struct sk_buff *skb)
 				udelay(6); /* wait at least 5,21us */
 				HFC_outb(hc, A_ST_WR_STATE, 3); /* activate */
 				break;
+			case HW_D_CHAIN_ON: /* layer2 accepts PH_DATA_CHAIN_IND */
+				test_and_set_bit(FLG_RX_CHAIN, &ch->Flags);
+				break;
+			case HW_D_CHAIN_OFF:
+				stop_ch_chain(ch);
+				break;
 			default:
 				printk(KERN_DEBUG "%s: unknown PH_CONTROL info %x\n",
 					__FUNCTION__, hh->dinfo);
@@ -2659,6 +2865,7 @@ handle_dmsg(channel_t *ch, struct sk_buff *skb)
 hw_deactivate:
 			//ch->state = 0;
 			ch->state = 1;
+			stop_ch_chain(ch);
 
 			/* start deactivation */
 			if (hc->type == 1) {
@@ -3091,6 +3298,9 @@ static void ph_state_change(channel_t *dch)
 		}
 	}
 
+	if ((prim == (PH_DEACTIVATE | INDICATION)) ||
+		(para == HW_RESET) || (para == HW_DEACTIVATE))
+		stop_ch_chain(dch);
 	mISDN_queue_data(&dch->inst, FLG_MSG_UP, prim, para, 0, NULL, 0);
 	if ((hc->type == 1) || test_bit(HFC_CFG_NTMODE, &hc->chan[ch].cfg))
 		mISDN_queue_data(&dch->inst, dch->inst.id | MSG_BROADCAST,
@@ -3569,6 +3779,57 @@ setup_pci(hfc_multi_t *hc, struct pci_dev *pdev, int id_idx)
 
 
 
+/*******************************/
+/* interrupt statistics, sysfs */
+/*******************************/
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
+#define HFCM_SYSFS
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,13)
+static ssize_t
+show_irqstat(struct device *dev, struct device_attribute *attr, char *buf)
+#else
+static ssize_t
+show_irqstat(struct device *dev, char *buf)
+#endif
+{
+	hfc_multi_t	*hc = dev_get_drvdata(dev);
+
+	if (!hc)
+		return(-ENODEV);
+	return(sprintf(buf, "irqs %u\ntimer %lu\nfifo %lu\npolling %d\n"
+		"poll_runs %lu\npoll_chan %lu\npoll_budget %lu\n"
+		"poll_enter %lu\npoll_exit %lu\n",
+		hc->irqcnt, hc->irqstat.timer, hc->irqstat.fifo, hc->polling,
+		hc->irqstat.poll_runs, hc->irqstat.poll_chan,
+		hc->irqstat.poll_budget, hc->irqstat.poll_enter,
+		hc->irqstat.poll_exit));
+}
+static DEVICE_ATTR(irqstat, S_IRUGO, show_irqstat, NULL);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,13)
+static ssize_t
+show_loopstat(struct device *dev, struct device_attribute *attr, char *buf)
+#else
+static ssize_t
+show_loopstat(struct device *dev, char *buf)
+#endif
+{
+	hfc_multi_t	*hc = dev_get_drvdata(dev);
+	int		i, samples = 0;
+
+	if (!hc)
+		return(-ENODEV);
+	for (i = 0; i < HFC_LOOP_TAB; i++)
+		if (hc->loop_tab[i].data)
+			samples++;
+	return(sprintf(buf, "samples %d\nuploads %lu\navoided %lu\n",
+		samples, hc->loop_uploads, hc->loop_avoided));
+}
+static DEVICE_ATTR(loopstat, S_IRUGO, show_loopstat, NULL);
+#endif
+
 static void release_ports_hw(hfc_multi_t *hc)
 {
 	u_long flags, flags2;
@@ -3579,6 +3840,14 @@ static void release_ports_hw(hfc_multi_t *hc)
 	disable_hwirq(hc);
 
 	spin_unlock_irqrestore(&hc->lock, flags);
+
+	tasklet_kill(&hc->poll_tasklet);
+#ifdef HFCM_SYSFS
+	if (hc->pci_dev) {
+		device_remove_file(&hc->pci_dev->dev, &dev_attr_irqstat);
+		device_remove_file(&hc->pci_dev->dev, &dev_attr_loopstat);
+	}
+#endif
 	
 	udelay(1000);
 	
@@ -3628,6 +3897,7 @@ static void release_ports_hw(hfc_multi_t *hc)
 #endif
 
 	release_io_hfcmulti(hc);
+	hfcmulti_loop_free(hc);
 
 	if (hc->irq) {
 		if (debug & DEBUG_HFCMULTI_INIT)
@@ -4008,6 +4278,10 @@ static int __devinit hfcpci_probe(struct pci_dev *pdev, const struct pci_device_
 		hc->wdbyte=V_GPIO_OUT2;
 		printk(KERN_NOTICE "Watchdog enabled\n");
 	}
+#ifndef CONFIG_PLX_PCI_BRIDGE
+	if (!(type[HFC_idx] & 0x100000))
+		test_and_set_bit(HFC_CHIP_FIFO32, &hc->chip);
+#endif
 	if (hc->type == 1)
 		sprintf(hc->name, "HFC-E1#%d", HFC_idx+1);
 	else
@@ -4023,6 +4297,7 @@ static int __devinit hfcpci_probe(struct pci_dev *pdev, const struct pci_device_
 		printk(KERN_DEBUG "%s: (after APPEND_TO_LIST)\n", __FUNCTION__);
 
 	spin_lock_init(&hc->lock);
+	tasklet_init(&hc->poll_tasklet, hfcmulti_poll, (u_long)hc);
 
 	pt = 0;
 	while (pt < hc->ports) {
@@ -4061,6 +4336,7 @@ static int __devinit hfcpci_probe(struct pci_dev *pdev, const struct pci_device_
 #endif
 		mISDN_init_instance(&chan->inst, &HFCM_obj, hc, hfcmulti_l2l1);
 		chan->inst.pid.layermask = ISDN_LAYER(0);
+		chan->inst.extentions |= EXT_INST_DCHAIN;
 		sprintf(chan->inst.name, "HFCm%d/%d", HFC_idx+1, pt+1);
 		ret_err = mISDN_initchannel(chan, MSK_INIT_DCHANNEL, MAX_DFRAME_LEN_L1);
 		if (ret_err)
@@ -4369,6 +4645,14 @@ free_delstack:
 	allocated[HFC_idx] = 1;
 	HFC_cnt++;
 	spin_unlock_irqrestore(&hc->lock, flags);
+#ifdef HFCM_SYSFS
+	if (device_create_file(&hc->pci_dev->dev, &dev_attr_irqstat))
+		printk(KERN_WARNING "%s: cannot create irqstat attribute\n",
+			hc->name);
+	if (device_create_file(&hc->pci_dev->dev, &dev_attr_loopstat))
+		printk(KERN_WARNING "%s: cannot create loopstat attribute\n",
+			hc->name);
+#endif
 
 	HFC_idx++;
 	HFC_port_idx+=hc->ports;
@@ -15,7 +15,6 @@ typedef unsigned long DWORD;
 //#define CONFIG_PLX_PCI_BRIDGE   // TODO should be defined in kernel config
 
 #ifdef CONFIG_PLX_PCI_BRIDGE
-#undef FIFO_32BIT_ACCESS
 #ifndef CONFIG_HFCMULTI_PCIMEM
 #define CONFIG_HFCMULTI_PCIMEM
 #endif
@@ -56,6 +55,7 @@ struct hfc_chan {
 	int		bank_rx;
 	int		conf;	/* conference setting of TX slot */
 	int		txpending; /* if there is currently data in the FIFO 0=no, 1=yes, 2=splloop */
+	int		loop;	/* sample in the FIFO, loop_tab index + 1 or HFC_LOOP_* */
 	int		e1_state; /* keep track of last state */
 };
 
@@ -105,6 +105,59 @@ typedef struct hfcmulti_hw	hfcmulti_hw_t;
 					to the watchdog */
 #define HFC_CHIP_DIGICARD       11 /* wether we have a b410p with echocan in 
 					hw */
+#define HFC_CHIP_FIFO32		12 /* 32 bit fifo data access */
+
+/*
+ * sample loop cache, each different tone sample is stored once per card and
+ * the channels remember which one is in their FIFO, so a running loop is not
+ * uploaded again, see hfcmulti_splloop()
+ */
+#define HFC_LOOP_TAB	16
+#define HFC_LOOP_NONE	0	/* FIFO content unknown */
+#define HFC_LOOP_OFF	-1	/* FIFO was reset to silence */
+
+typedef struct _hfcmulti_loop {
+	u_char		*data;
+	int		len;
+} hfcmulti_loop_t;
+
+/* interrupt and poll statistics */
+typedef struct _hfcmulti_irqstat {
+	u_long		timer;		/* chip timer IRQs */
+	u_long		fifo;		/* FIFO IRQs */
+	u_long		poll_runs;	/* runs of the poll tasklet */
+	u_long		poll_chan;	/* channels serviced by the tasklet */
+	u_long		poll_budget;	/* runs which exhausted the budget */
+	u_long		poll_enter;	/* switches to polling mode */
+	u_long		poll_exit;	/* switches back to FIFO IRQs */
+} hfcmulti_irqstat_t;
+
+#ifdef HFC_REGISTER_SIM
+/*
+ * register model of the FIFOs (internal RAM setting), the counters and
+ * the IRQ status, see the HFC_REGISTER_SIM accessors below
+ */
+#define HFCSIM_FIFOS	64	/* 32 channels, tx and rx */
+#define HFCSIM_ZMIN	0x80
+#define HFCSIM_ZLEN	384
+#define HFCSIM_FLEN	0x10
+
+typedef struct _hfcsim_fifo {
+	u_short		z1, z2;		/* next write, next read */
+	u_char		f1, f2;		/* frame counters */
+	u_short		fz[HFCSIM_FLEN];/* Z at the end of each frame */
+	u_char		irq_msk;	/* A_IRQ_MSK */
+	u_char		ram[HFCSIM_ZLEN];
+} hfcsim_fifo_t;
+
+typedef struct _hfcsim {
+	u_char		reg[256];	/* plain registers, last value written */
+	u_char		fifo;		/* R_FIFO */
+	u_char		irq_fifo_bl[8];
+	u_char		irq_misc;
+	hfcsim_fifo_t	f[HFCSIM_FIFOS];
+} hfcsim_t;
+#endif
 
 struct hfc_multi {
 	struct list_head	list;
@@ -148,6 +201,20 @@ struct hfc_multi {
 
 	spinlock_t	lock;	/* the lock */
 
+	/* FIFO IRQs are masked and the channels are serviced by the
+	 * tasklet while polling is set, see hfcmulti_irq_coalesce()
+	 */
+	struct tasklet_struct	poll_tasklet;
+	u_int		fifo_irqs;	/* FIFO IRQs since last timer IRQ */
+	int		polling;
+	int		poll_hold;	/* timer IRQs until FIFO IRQs are enabled */
+	int		poll_next;	/* next channel to service by tasklet */
+	hfcmulti_irqstat_t	irqstat;
+
+	hfcmulti_loop_t	loop_tab[HFC_LOOP_TAB];
+	u_long		loop_uploads;	/* samples written to a FIFO */
+	u_long		loop_avoided;	/* sample loop requests without upload */
+
 	/* the channel index is counted from 0, regardless where the channel
 	 * is located on the hfc-channel.
 	 * the bch->channel is equvalent to the hfc-channel
@@ -155,6 +222,9 @@ struct hfc_multi {
 	hfc_chan_t	chan[32];
 	u_char		created[8]; /* what port is created */
 	signed char	slot_owner[256]; /* owner channel of slot */
+#ifdef HFC_REGISTER_SIM
+	hfcsim_t	*sim;
+#endif
 };
 
 typedef struct hfc_multi	hfc_multi_t;
@@ -1112,12 +1182,270 @@ struct hfc_register_names {
 #define ADDR_MULT 1   // can be defined to other values if there
 					  // is e.g. an offset in a bridge chip addressing
 
+#ifdef HFC_REGISTER_SIM
+
+/*
+ * No card: all register accesses go to the model in hc->sim, so the
+ * FIFO and interrupt code of this driver can run in a host process.
+ * The harness sets hc->sim to a zeroed hfcsim_t and hc->Zmin, Zlen and
+ * Flen as init_chip() does for the internal RAM, plays the line side
+ * with hfcsim_rx(), hfcsim_tx() and hfcsim_timer() and calls
+ * hfcmulti_interrupt() while hfcsim_irq() is set.
+ * Simplifications: the chip is never busy, R_IRQ_FIFO_BLx is cleared
+ * when the FIFO is selected with R_FIFO and not by the read (the
+ * interrupt handler reads it twice), PCM and the S/T or E1 state
+ * machines are not modelled, other registers read back what was written.
+ */
+#ifndef CONFIG_HFCMULTI_PCIMEM
+#error Please use "HFC_REGISTER_SIM" only in conjuction with PCIMEM access.
+#endif
+#ifdef HFC_REGISTER_MAP
+#error "HFC_REGISTER_SIM" and "HFC_REGISTER_MAP" do not go together.
+#endif
+
+static inline u_short hfcsim_znext(u_short z)
+{
+	return((z + 1 >= HFCSIM_ZMIN + HFCSIM_ZLEN) ? HFCSIM_ZMIN : z + 1);
+}
+
+static inline hfcsim_fifo_t *hfcsim_fifo(hfcsim_t *s, int ch, int rx)
+{
+	return(&s->f[((ch & 0x1f) << 1) | rx]);
+}
+
+static inline void hfcsim_set_irq(hfcsim_t *s, int ch, int rx)
+{
+	int	n = ((ch & 0x1f) << 1) | rx;
+
+	if (s->f[n].irq_msk & V_IRQ)
+		s->irq_fifo_bl[n >> 3] |= 1 << (n & 7);
+}
+
+static BYTE hfcsim_inb(hfc_multi_t *a, BYTE b)
+{
+	hfcsim_t	*s = a->sim;
+	hfcsim_fifo_t	*f = &s->f[s->fifo & 0x3f];
+	u_char		c;
+	int		i;
+
+	switch (b) {
+	case A_FIFO_DATA0:
+		if (!(s->fifo & 1) || f->z2 == f->z1)
+			return(0xff);
+		c = f->ram[f->z2 - HFCSIM_ZMIN];
+		f->z2 = hfcsim_znext(f->z2);
+		return(c);
+	case A_F1:
+		return(f->f1);
+	case A_F2:
+		return(f->f2);
+	case R_STATUS:
+		c = 0;
+		for (i = 0; i < 8; i++)
+			if (s->irq_fifo_bl[i])
+				c |= V_FR_IRQSTA;
+		if (s->irq_misc)
+			c |= V_MISC_IRQSTA;
+		return(c);
+	case R_IRQ_MISC:
+		c = s->irq_misc;
+		s->irq_misc = 0;
+		return(c);
+	case R_IRQ_OVIEW:
+		c = 0;
+		for (i = 0; i < 8; i++)
+			if (s->irq_fifo_bl[i])
+				c |= 1 << i;
+		return(c);
+	case R_IRQ_STATECH:
+		return(0);
+	}
+	if (b >= R_IRQ_FIFO_BL0 && b <= R_IRQ_FIFO_BL7)
+		return(s->irq_fifo_bl[b - R_IRQ_FIFO_BL0]);
+	return(s->reg[b]);
+}
+
+static WORD hfcsim_inw(hfc_multi_t *a, BYTE b)
+{
+	hfcsim_t	*s = a->sim;
+	hfcsim_fifo_t	*f = &s->f[s->fifo & 0x3f];
+	WORD		w;
+
+	switch (b) {
+	case A_Z1:
+		/* with a complete rx frame, the end of the oldest one */
+		if ((s->fifo & 1) && f->f1 != f->f2)
+			return(f->fz[f->f2]);
+		return(f->z1);
+	case A_Z2:
+		return(f->z2);
+	case A_F12:
+		return(f->f1 | (f->f2 << 8));
+	case A_FIFO_DATA0:
+		w = hfcsim_inb(a, b);
+		return(w | (hfcsim_inb(a, b) << 8));
+	}
+	return(hfcsim_inb(a, b));
+}
+
+static u32 hfcsim_inl(hfc_multi_t *a, BYTE b)
+{
+	u32	l;
+
+	if (b == A_Z12)
+		return(hfcsim_inw(a, A_Z1) | (hfcsim_inw(a, A_Z2) << 16));
+	l = hfcsim_inw(a, b);
+	if (b == A_FIFO_DATA0)
+		l |= hfcsim_inw(a, b) << 16;
+	return(l);
+}
+
+static void hfcsim_outb(hfc_multi_t *a, BYTE b, BYTE c)
+{
+	hfcsim_t	*s = a->sim;
+	hfcsim_fifo_t	*f = &s->f[s->fifo & 0x3f];
+	int		n;
+
+	switch (b) {
+	case A_FIFO_DATA0:
+		if ((s->fifo & 1) || hfcsim_znext(f->z1) == f->z2)
+			return;
+		f->ram[f->z1 - HFCSIM_ZMIN] = c;
+		f->z1 = hfcsim_znext(f->z1);
+		return;
+	case A_FIFO_DATA0_NOINC:
+		if (!(s->fifo & 1))
+			f->ram[f->z1 - HFCSIM_ZMIN] = c;
+		return;
+	case R_FIFO:
+		/* selecting a FIFO acknowledges its interrupt */
+		s->fifo = ((c >> 1) & 0x1f) << 1 | (c & 1);
+		n = s->fifo;
+		s->irq_fifo_bl[n >> 3] &= ~(1 << (n & 7));
+		return;
+	case R_INC_RES_FIFO:
+		if (c & V_RES_F) {
+			f->z1 = f->z2 = HFCSIM_ZMIN;
+			f->f1 = f->f2 = 0;
+		} else if (c & V_INC_F) {
+			if (s->fifo & 1) {
+				if (f->f1 != f->f2) {
+					f->z2 = hfcsim_znext(f->fz[f->f2]);
+					f->f2 = (f->f2 + 1) & (HFCSIM_FLEN - 1);
+				}
+			} else {
+				f->fz[f->f1] = f->z1;
+				f->f1 = (f->f1 + 1) & (HFCSIM_FLEN - 1);
+			}
+		}
+		return;
+	case A_IRQ_MSK:
+		f->irq_msk = c;
+		return;
+	}
+	s->reg[b] = c;
+}
+
+static void hfcsim_outw(hfc_multi_t *a, BYTE b, WORD c)
+{
+	hfcsim_outb(a, b, c & 0xff);
+	if (b == A_FIFO_DATA0)
+		hfcsim_outb(a, b, c >> 8);
+}
+
+static void hfcsim_outl(hfc_multi_t *a, BYTE b, u32 c)
+{
+	hfcsim_outw(a, b, c & 0xffff);
+	if (b == A_FIFO_DATA0)
+		hfcsim_outw(a, b, c >> 16);
+}
+
+/* line side: len octets received on channel ch, as one frame if hdlc */
+static int hfcsim_rx(hfc_multi_t *a, int ch, u_char *data, int len, int hdlc)
+{
+	hfcsim_fifo_t	*f = hfcsim_fifo(a->sim, ch, 1);
+	u_short		z = f->z1;
+	int		i, n = hdlc ? len + 3 : len;
+
+	if (hdlc && ((f->f1 + 1) & (HFCSIM_FLEN - 1)) == f->f2)
+		return(-1);
+	for (i = 0; i < n; i++) {
+		if (hfcsim_znext(z) == f->z2)
+			return(-1);
+		/* hdlc: CRC octets and status 0 (CRC ok) behind the data */
+		f->ram[z - HFCSIM_ZMIN] = (i < len) ? data[i] : 0;
+		z = hfcsim_znext(z);
+	}
+	if (hdlc) {
+		/* Z of the last octet of the frame */
+		f->fz[f->f1] = f->z1 + n - 1;
+		if (f->fz[f->f1] >= HFCSIM_ZMIN + HFCSIM_ZLEN)
+			f->fz[f->f1] -= HFCSIM_ZLEN;
+		f->f1 = (f->f1 + 1) & (HFCSIM_FLEN - 1);
+	}
+	f->z1 = z;
+	hfcsim_set_irq(a->sim, ch, 1);
+	return(len);
+}
+
+/* line side: send up to max octets of channel ch, one frame if hdlc */
+static int hfcsim_tx(hfc_multi_t *a, int ch, u_char *buf, int max, int hdlc)
+{
+	hfcsim_fifo_t	*f = hfcsim_fifo(a->sim, ch, 0);
+	u_short		end = f->z1;
+	int		len = 0;
+
+	if (hdlc) {
+		if (f->f1 == f->f2)
+			return(0);
+		end = f->fz[f->f2];
+		f->f2 = (f->f2 + 1) & (HFCSIM_FLEN - 1);
+	}
+	while (f->z2 != end && len < max) {
+		buf[len++] = f->ram[f->z2 - HFCSIM_ZMIN];
+		f->z2 = hfcsim_znext(f->z2);
+	}
+	f->z2 = end;
+	hfcsim_set_irq(a->sim, ch, 0);
+	return(len);
+}
+
+/* line side: one tick of the chip timer (R_TI_WD) */
+static void hfcsim_timer(hfc_multi_t *a)
+{
+	if (a->sim->reg[R_IRQMSK_MISC] & V_TI_IRQMSK)
+		a->sim->irq_misc |= V_TI_IRQ;
+}
+
+/* the interrupt line of the model */
+static int hfcsim_irq(hfc_multi_t *a)
+{
+	return(hfcsim_inb(a, R_STATUS) != 0);
+}
+
+#define HFC_outb(a,b,c) hfcsim_outb(a,b,c)
+#define HFC_outw(a,b,c) hfcsim_outw(a,b,c)
+#define HFC_outl(a,b,c) hfcsim_outl(a,b,c)
+#define HFC_inb(a,b) hfcsim_inb(a,b)
+#define HFC_inw(a,b) hfcsim_inw(a,b)
+#define HFC_inl(a,b) hfcsim_inl(a,b)
+#define HFC_wait(a) do {} while (0)
+#define HFC_outb_(a,b,c) hfcsim_outb(a,b,c)
+#define HFC_outw_(a,b,c) hfcsim_outw(a,b,c)
+#define HFC_outl_(a,b,c) hfcsim_outl(a,b,c)
+#define HFC_inb_(a,b) hfcsim_inb(a,b)
+#define HFC_inw_(a,b) hfcsim_inw(a,b)
+#define HFC_inl_(a,b) hfcsim_inl(a,b)
+#define HFC_wait_(a) do {} while (0)
+
+#else /* HFC_REGISTER_SIM */
+
 #ifdef CONFIG_HFCMULTI_PCIMEM
 
-#define HFC_outl(a,b,c) (*((volatile u_long *)((a->pci_membase)+((b)*ADDR_MULT))) = c)
-#define HFC_inl(a,b) (*((volatile u_long *)((a->pci_membase)+((b)*ADDR_MULT))))
-#define HFC_outl_(a,b,c) (*((volatile u_long *)((a->pci_membase)+((b)*ADDR_MULT))) = c)
-#define HFC_inl_(a,b) (*((volatile u_long *)((a->pci_membase)+((b)*ADDR_MULT))))
+#define HFC_outl(a,b,c) (*((volatile u32 *)((a->pci_membase)+((b)*ADDR_MULT))) = c)
+#define HFC_inl(a,b) (*((volatile u32 *)((a->pci_membase)+((b)*ADDR_MULT))))
+#define HFC_outl_(a,b,c) (*((volatile u32 *)((a->pci_membase)+((b)*ADDR_MULT))) = c)
+#define HFC_inl_(a,b) (*((volatile u32 *)((a->pci_membase)+((b)*ADDR_MULT))))
 #define HFC_outw_(a,b,c) (*((volatile u_short *)((a->pci_membase)+((b)*ADDR_MULT))) = c)
 #define HFC_inw_(a,b) (*((volatile u_short *)((a->pci_membase)+((b)*ADDR_MULT))))
 /*
@@ -1250,7 +1578,7 @@ static inline void HFC_outb(hfc_multi_t *a, unsigned short b, u_char c)
 	outw(b,(a->pci_iobase)+4);
 	outb(c,a->pci_iobase);
 }
-static inline void HFC_outl(hfc_multi_t *a, unsigned short b, u_long c)
+static inline void HFC_outl(hfc_multi_t *a, unsigned short b, u32 c)
 {
 	outw(b,(a->pci_iobase)+4);
 	outl(c,a->pci_iobase);
@@ -1273,7 +1601,7 @@ static inline u_short HFC_inw(hfc_multi_t *a, unsigned short b)
 	outw(b,(a->pci_iobase)+4);
 	return (inw((volatile u_int)a->pci_iobase));
 }
-static inline u_long HFC_inl(hfc_multi_t *a, unsigned short b)
+static inline u32 HFC_inl(hfc_multi_t *a, unsigned short b)
 {
 	outw(b,(a->pci_iobase)+4);
 	return (inl((volatile u_int)a->pci_iobase));
@@ -1309,3 +1637,5 @@ static inline void HFC_wait(hfc_multi_t *a)
 
 #endif /* else CONFIG_HFCMULTI_PCIMEM */
 
+#endif /* else HFC_REGISTER_SIM */
+
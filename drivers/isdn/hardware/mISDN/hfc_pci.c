@@ -36,6 +36,7 @@
 #include "hfc_pci.h"
 #include "layer1.h"
 #include "debug.h"
+#include "irq_bh.h"
 #include <mISDN/isdn_compat.h>
 
 #define HFC_INFO(txt)	printk(KERN_DEBUG txt)
@@ -170,6 +171,23 @@ typedef struct hfcPCI_hw	hfcPCI_hw_t;
 #define HFC_CFG_NEG_F0		6
 #define HFC_CFG_SW_DD_DU	7
 
+/*
+ * transparent B-channel receive buffers, the skbs are given to the upper
+ * layers with an extra reference and used again for the next chunk after
+ * the upper layers did free them, so normally no skb is allocated per chunk
+ */
+#define HFCPCI_RXPOOL	4
+
+typedef struct {
+	struct sk_buff	*skb[HFCPCI_RXPOOL];
+	int		next;
+	u_long		frames;
+	u_long		bytes;
+	u_long		copies;
+	u_long		allocs;
+	u_long		reused;
+} hfcpci_rxpool_t;
+
 typedef struct _hfc_pci {
 	struct list_head	list;
 	u_char			subtyp;
@@ -181,6 +199,9 @@ typedef struct _hfc_pci {
 	spinlock_t		lock;
 	channel_t		dch;
 	channel_t		bch[2];
+	hfcpci_rxpool_t		rxpool[2];
+	mISDN_irq_bh_t		bh;
+	u_char			int_s1;	/* saved by hardirq for the bottom half */
 } hfc_pci_t;
 
 /* Interface functions */
@@ -552,12 +573,56 @@ receive_dmsg(hfc_pci_t *hc)
 	return (1);
 }
 
+/*******************************************************/
+/* get a receive skb for transparent data from the pool */
+/*******************************************************/
+static struct sk_buff *
+hfcpci_rxpool_get(channel_t *bch, hfcpci_rxpool_t *pool)
+{
+	struct sk_buff	*skb = pool->skb[pool->next];
+
+	/* only our reference is left, nobody else uses the data */
+	if (skb && !skb_shared(skb) && !skb_cloned(skb) && !skb->sk) {
+		skb->data = skb->head + bch->up_headerlen;
+		__skb_trim(skb, 0);
+		if (skb_tailroom(skb) >= HFCPCI_BTRANS_THRESHOLD) {
+			pool->reused++;
+			goto done;
+		}
+	}
+	/* still in use or not usable, the last user frees it */
+	if (skb)
+		dev_kfree_skb_any(skb);
+	skb = alloc_stack_skb(HFCPCI_BTRANS_THRESHOLD, bch->up_headerlen);
+	pool->skb[pool->next] = skb;
+	if (!skb)
+		return(NULL);
+	pool->allocs++;
+done:
+	pool->next = (pool->next + 1) % HFCPCI_RXPOOL;
+	return(skb_get(skb));
+}
+
+static void
+hfcpci_rxpool_free(hfcpci_rxpool_t *pool)
+{
+	int	i;
+
+	for (i = 0; i < HFCPCI_RXPOOL; i++) {
+		if (pool->skb[i])
+			dev_kfree_skb_any(pool->skb[i]);
+		pool->skb[i] = NULL;
+	}
+}
+
 /*******************************************************************************/
 /* check for transparent receive data and read max one threshold size if avail */
 /*******************************************************************************/
 int
 hfcpci_empty_fifo_trans(channel_t *bch, bzfifo_type * bz, u_char * bdata)
 {
+	hfc_pci_t	*hc = bch->hw;
+	hfcpci_rxpool_t	*pool = &hc->rxpool[bch == &hc->bch[1]];
 	unsigned short	*z1r, *z2r;
 	int		new_z2, fcnt, maxlen;
 	u_char		*ptr, *ptr1;
@@ -577,9 +642,12 @@ hfcpci_empty_fifo_trans(channel_t *bch, bzfifo_type * bz, u_char * bdata)
 	if (new_z2 >= (B_FIFO_SIZE + B_SUB_VAL))
 		new_z2 -= B_FIFO_SIZE;	/* buffer wrap */
 
-	if (!(bch->rx_skb = alloc_stack_skb(fcnt, bch->up_headerlen)))
+	if (!(bch->rx_skb = hfcpci_rxpool_get(bch, pool)))
 		printk(KERN_WARNING "HFCPCI: receive out of memory\n");
 	else {
+		pool->frames++;
+		pool->bytes += fcnt;
+		pool->copies++;
 		ptr = skb_put(bch->rx_skb, fcnt);
 		if (le16_to_cpu(*z2r) + fcnt <= B_FIFO_SIZE + B_SUB_VAL)
 			maxlen = fcnt;	/* complete transfer */
@@ -594,6 +662,7 @@ hfcpci_empty_fifo_trans(channel_t *bch, bzfifo_type * bz, u_char * bdata)
 			ptr += maxlen;
 			ptr1 = bdata;	/* start of buffer */
 			memcpy(ptr, ptr1, fcnt);	/* rest */
+			pool->copies++;
 		}
 		queue_ch_frame(bch, INDICATION, MISDN_ID_ANY, bch->rx_skb);
 		bch->rx_skb = NULL;
@@ -1035,31 +1104,13 @@ tx_irq(channel_t *chan)
 	}
 }
 
-static irqreturn_t
-hfcpci_interrupt(int intno, void *dev_id, struct pt_regs *regs)
+static int irq_bh;	/* use the common bottom half, module parameter */
+
+static void
+hfcpci_handle_int(hfc_pci_t *hc, u_char val)
 {
-	hfc_pci_t	*hc = dev_id;
 	u_char		exval;
 	channel_t	*bch;
-	u_char		val, stat;
-
-	spin_lock(&hc->lock);
-	if (!(hc->hw.int_m2 & 0x08)) {
-		spin_unlock(&hc->lock);
-		return IRQ_NONE; /* not initialised */
-	}
-
-	if (HFCPCI_ANYINT & (stat = Read_hfc(hc, HFCPCI_STATUS))) {
-		val = Read_hfc(hc, HFCPCI_INT_S1);
-		if (hc->dch.debug & L1_DEB_ISAC)
-			mISDN_debugprint(&hc->dch.inst, "HFC-PCI: stat(%02x) s1(%02x)",
-				stat, val);
-	} else {
-		/* shared */
-		spin_unlock(&hc->lock);
-		return IRQ_NONE;
-	}
-	hc->irqcnt++;
 
 	if (hc->dch.debug & L1_DEB_ISAC)
 		mISDN_debugprint(&hc->dch.inst, "HFC-PCI irq %x", val);
@@ -1120,6 +1171,61 @@ hfcpci_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 			del_timer(&hc->dch.timer);
 		tx_irq(&hc->dch);
 	}
+}
+
+/*
+ * bottom half, one work unit is one INT_S1 value; reading INT_S1 clears
+ * it, so the hardirq handler does not need to mask the chip
+ */
+static int
+hfcpci_bh_work(mISDN_irq_bh_t *bh, int budget)
+{
+	hfc_pci_t	*hc = bh->priv;
+	u_char		val;
+	u_long		flags;
+	int		cnt = 0;
+
+	spin_lock_irqsave(&hc->lock, flags);
+	while (cnt < budget) {
+		if (!(val = hc->int_s1))
+			break;
+		hc->int_s1 = 0;
+		hfcpci_handle_int(hc, val);
+		cnt++;
+	}
+	spin_unlock_irqrestore(&hc->lock, flags);
+	return(cnt);
+}
+
+static irqreturn_t
+hfcpci_interrupt(int intno, void *dev_id, struct pt_regs *regs)
+{
+	hfc_pci_t	*hc = dev_id;
+	u_char		val, stat;
+
+	spin_lock(&hc->lock);
+	if (!(hc->hw.int_m2 & 0x08)) {
+		spin_unlock(&hc->lock);
+		return IRQ_NONE; /* not initialised */
+	}
+	mISDN_irq_bh_enter(&hc->bh);
+	if (HFCPCI_ANYINT & (stat = Read_hfc(hc, HFCPCI_STATUS))) {
+		val = Read_hfc(hc, HFCPCI_INT_S1);
+		if (hc->dch.debug & L1_DEB_ISAC)
+			mISDN_debugprint(&hc->dch.inst, "HFC-PCI: stat(%02x) s1(%02x)",
+				stat, val);
+	} else {
+		/* shared */
+		spin_unlock(&hc->lock);
+		return IRQ_NONE;
+	}
+	hc->irqcnt++;
+	if (irq_bh) {
+		hc->int_s1 |= val;
+		mISDN_irq_bh_schedule(&hc->bh);
+	} else
+		hfcpci_handle_int(hc, val);
+	mISDN_irq_bh_leave(&hc->bh);
 	spin_unlock(&hc->lock);
 	return IRQ_HANDLED;
 }
@@ -1816,12 +1922,15 @@ MODULE_LICENSE("GPL");
 #endif
 #ifdef OLD_MODULE_PARAM
 MODULE_PARM(debug, "1i");
+MODULE_PARM(irq_bh, "1i");
 #define MODULE_PARM_T   "1-4i"
 MODULE_PARM(protocol, MODULE_PARM_T);
 MODULE_PARM(layermask, MODULE_PARM_T);
 #else
 module_param (debug, uint, 0);
 MODULE_PARM_DESC (debug, "hfcpci debug mask");
+module_param (irq_bh, uint, S_IRUGO);
+MODULE_PARM_DESC (irq_bh, "FIFO work in the common bottom half (default 0)");
 #ifdef OLD_MODULE_PARAM_ARRAY
 static int	protocol_cnt;
 module_param_array(protocol, uint, protocol_cnt, 0);
@@ -1942,14 +2051,52 @@ setup_hfcpci(hfc_pci_t *hc)
 	return (0);
 }
 
+/************************************/
+/* transparent receive statistics   */
+/************************************/
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
+#define HFCPCI_SYSFS
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,13)
+static ssize_t
+show_rxstat(struct device *dev, struct device_attribute *attr, char *buf)
+#else
+static ssize_t
+show_rxstat(struct device *dev, char *buf)
+#endif
+{
+	hfc_pci_t	*hc = dev_get_drvdata(dev);
+	char		*p = buf;
+	int		i;
+
+	if (!hc)
+		return(-ENODEV);
+	for (i = 0; i < 2; i++)
+		p += sprintf(p, "B%d frames %lu bytes %lu copies %lu allocs %lu "
+			"reused %lu\n", i + 1, hc->rxpool[i].frames,
+			hc->rxpool[i].bytes, hc->rxpool[i].copies,
+			hc->rxpool[i].allocs, hc->rxpool[i].reused);
+	return(p - buf);
+}
+static DEVICE_ATTR(rxstat, S_IRUGO, show_rxstat, NULL);
+#endif
+
 static void
 release_card(hfc_pci_t *hc) {
 	u_long	flags;
 
+#ifdef HFCPCI_SYSFS
+	device_remove_file(&hc->hw.dev->dev, &dev_attr_rxstat);
+	pci_set_drvdata(hc->hw.dev, NULL);
+#endif
 	free_irq(hc->irq, hc);
+	mISDN_irq_bh_kill(&hc->bh);
 	spin_lock_irqsave(&hc->lock, flags);
 	mode_hfcpci(&hc->bch[0], 1, ISDN_PID_NONE);
 	mode_hfcpci(&hc->bch[1], 2, ISDN_PID_NONE);
+	hfcpci_rxpool_free(&hc->rxpool[0]);
+	hfcpci_rxpool_free(&hc->rxpool[1]);
 	if (hc->dch.timer.function != NULL) {
 		del_timer(&hc->dch.timer);
 		hc->dch.timer.function = NULL;
@@ -2200,8 +2347,11 @@ static int __init HFC_init(void)
 		}
 		printk(KERN_DEBUG "HFC card %p dch %p bch1 %p bch2 %p\n",
 			card, &card->dch, &card->bch[0], &card->bch[1]);
+		mISDN_irq_bh_init(&card->bh, card->dch.inst.name,
+			hfcpci_bh_work, card, MISDN_BH_BUDGET);
 		if (setup_hfcpci(card)) {
 			err = 0;
+			mISDN_irq_bh_kill(&card->bh);
 			mISDN_freechannel(&card->dch);
 			mISDN_freechannel(&card->bch[1]);
 			mISDN_freechannel(&card->bch[0]);
@@ -2217,6 +2367,11 @@ static int __init HFC_init(void)
 					HFC_cnt);
 			return(err);
 		}
+#ifdef HFCPCI_SYSFS
+		pci_set_drvdata(card->hw.dev, card);
+		if (device_create_file(&card->hw.dev->dev, &dev_attr_rxstat))
+			printk(KERN_WARNING "HFC-PCI: cannot create rxstat attribute\n");
+#endif
 //		card->dch.inst.class_dev.dev = &card->hw.dev->dev;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
         card->dch.inst.class_dev.parent = &card->hw.dev->dev;
@@ -25,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/delay.h>
 #include <linux/usb.h>
+#include <linux/ktime.h>
 #include "core.h"
 #include "channel.h"
 #include "layer1.h"
@@ -43,6 +44,8 @@ static int layermask[MAX_CARDS];
 static mISDNobject_t hw_mISDNObj;
 static int debug = 0;
 static int poll = 128;
+static int iso_depth = ISOC_PACKETS_B;	/* ISO packets per URB */
+static int iso_adapt;	/* adapt iso_depth to ISO errors and latency */
 
 
 #ifdef MODULE
@@ -52,12 +55,16 @@ MODULE_LICENSE("GPL");
 #ifdef OLD_MODULE_PARAM
 MODULE_PARM(debug, "1i");
 MODULE_PARM(poll, "1i");
+MODULE_PARM(iso_depth, "1i");
+MODULE_PARM(iso_adapt, "1i");
 #define MODULE_PARM_T   "1-4i"
 MODULE_PARM(protocol, MODULE_PARM_T);
 MODULE_PARM(layermask, MODULE_PARM_T);
 #else
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 module_param(poll, uint, S_IRUGO | S_IWUSR);
+module_param(iso_depth, uint, S_IRUGO | S_IWUSR);
+module_param(iso_adapt, uint, S_IRUGO | S_IWUSR);
 
 #ifdef OLD_MODULE_PARAM_ARRAY
 static int num_protocol=0, num_layermask=0;
@@ -82,6 +89,17 @@ typedef struct iso_urb_struct {
 	struct usb_fifo *owner_fifo;	/* pointer to owner fifo */
 } iso_urb_struct;
 
+/* ISO statistics of one fifo */
+typedef struct iso_stat_struct {
+	u_long	urbs;		/* completed URBs */
+	u_long	errors;		/* ISO packets with error status */
+	u_long	underruns;	/* tx: transparent data ran out */
+	u_long	late;		/* completions more than 1 ms late */
+	u_long	max_lat;	/* max time between completions in us */
+	u_long	deeper;		/* URB depth raised */
+	u_long	shallower;	/* URB depth lowered */
+} iso_stat_struct;
+
 typedef struct usb_fifo {
 	int fifonum;		/* fifo index attached to this structure */
 	int active;		/* fifo is currently active */
@@ -96,6 +114,12 @@ typedef struct usb_fifo {
 
 	volatile __u8 usb_transfer_mode;	/* switched between ISO and INT */
 	iso_urb_struct iso[2];	/* need two urbs to have one always for pending */
+	int iso_packets;	/* ISO packets per URB (URB depth) */
+	int iso_max;		/* max ISO packets fitting in iso[].buffer */
+	int iso_quiet;		/* ms without ISO errors */
+	int tx_data;		/* last tx ISO packet carried data */
+	ktime_t iso_stamp;	/* monotonic time of last completion */
+	iso_stat_struct stat;
 	__u8 ch_idx;		/* link BChannel Fifos to chan[ch_idx] */
 	int last_urblen;	/* remember length of last packet */
 } usb_fifo;
@@ -496,6 +520,9 @@ S0_new_state(channel_t * dch)
 			SSTATUS_L1_ACTIVATED : SSTATUS_L1_DEACTIVATED,
 			0, NULL, 0);
 	}
+	if ((prim == (PH_DEACTIVATE | INDICATION)) ||
+		(para == HW_RESET) || (para == HW_DEACTIVATE))
+		stop_ch_chain(dch);
 	mISDN_queue_data(&dch->inst, FLG_MSG_UP, prim, para, 0, NULL, 0);
 
 	hfc_dt_state(dch->inst.st, dch->state, card->portmode & PORT_MODE_TE);
@@ -679,11 +706,13 @@ handle_dmsg(channel_t *dch, struct sk_buff *skb)
 		ret = -EINVAL;
 	} else if (hh->prim == (PH_CONTROL | REQUEST)) {
 		if (hh->dinfo == HW_RESET) {
+			stop_ch_chain(dch);
 			if (dch->state != 0)
 				hfcsusb_ph_command(hw, HFC_L1_ACTIVATE_TE);
 			skb_trim(skb, 0);
 			return(mISDN_queueup_newhead(&dch->inst, 0, PH_CONTROL | INDICATION,HW_POWERUP, skb));
 		} else if (hh->dinfo == HW_DEACTIVATE) {
+			stop_ch_chain(dch);
 			if (dch->next_skb) {
 				dev_kfree_skb(dch->next_skb);
 				dch->next_skb = NULL;
@@ -696,6 +725,11 @@ handle_dmsg(channel_t *dch, struct sk_buff *skb)
 #endif
 		} else if (hh->dinfo == HW_POWERUP) {
 			hfcsusb_ph_command(hw, HFC_L1_FORCE_DEACTIVATE_TE);
+		} else if (hh->dinfo == HW_D_CHAIN_ON) {
+			/* layer2 accepts PH_DATA_CHAIN_IND */
+			test_and_set_bit(FLG_RX_CHAIN, &dch->Flags);
+		} else if (hh->dinfo == HW_D_CHAIN_OFF) {
+			stop_ch_chain(dch);
 		} else {
 			if (dch->debug & L1_DEB_WARN)
 				mISDN_debugprint(&dch->inst,
@@ -716,6 +750,7 @@ handle_dmsg(channel_t *dch, struct sk_buff *skb)
 	} else if (hh->prim == (PH_DEACTIVATE | REQUEST)) {
 		if (hw->portmode & PORT_MODE_NT) {
 			hfcsusb_ph_command(hw, HFC_L1_DEACTIVATE_NT);
+			stop_ch_chain(dch);
 			if (test_and_clear_bit(FLG_TX_NEXT, &dch->Flags)) {
 				dev_kfree_skb(dch->next_skb);
 				dch->next_skb = NULL;
@@ -1011,15 +1046,31 @@ collect_rx_frame(usb_fifo * fifo, __u8 * data, unsigned int len, int finish)
 	channel_t	*ch = &card->chan[fifo->ch_idx];
 	struct sk_buff	*skb;	/* data buffer for upper layer */
 	int		fifon;
-	int		i;
+	int		i, size;
 
 	if (!len)
 		return;
 		
 	fifon = fifo->fifonum;
 
+	if (ch->rx_skb && !test_bit(FLG_HDLC, &ch->Flags) &&
+		skb_tailroom(ch->rx_skb) < len) {
+		/* poll was raised, deliver the transparent data we have */
+		if (ch->rx_skb->len)
+			queue_ch_frame(ch, INDICATION, MISDN_ID_ANY, ch->rx_skb);
+		else
+			dev_kfree_skb(ch->rx_skb);
+		ch->rx_skb = NULL;
+	}
 	if (!ch->rx_skb) {
-		ch->rx_skb = alloc_stack_skb(ch->maxlen + 3, ch->up_headerlen);
+		/* transparent data is delivered after poll bytes */
+		size = ch->maxlen + 3;
+		if (!test_bit(FLG_HDLC, &ch->Flags) &&
+			(poll + fifo->usb_packet_maxlen < size))
+			size = poll + fifo->usb_packet_maxlen;
+		if (size < len)
+			size = len;
+		ch->rx_skb = alloc_stack_skb(size, ch->up_headerlen);
 		if (!ch->rx_skb) {
 			if (ch->debug)
 				printk(KERN_DEBUG "%s: No mem for rx_skb\n", __FUNCTION__);
@@ -1085,7 +1136,7 @@ collect_rx_frame(usb_fifo * fifo, __u8 * data, unsigned int len, int finish)
 					skb = ch->rx_skb;
 					ch->rx_skb = NULL;
 				}
-				queue_ch_frame(ch, INDICATION, MISDN_ID_ANY, skb);
+				queue_ch_dframe(ch, skb);
 			} else {
 				if (ch->debug) {
 					printk ("HFC-S USB: CRC or minlen ERROR fifon(%i) RX len(%i): ",
@@ -1129,6 +1180,57 @@ fill_isoc_urb(struct urb *urb, struct usb_device *dev, unsigned int pipe,
 	}
 }
 
+/*
+ * account a completed ISO URB of packets ISO packets with errors ISO
+ * packet errors. With iso_adapt set, the URB depth is raised on errors
+ * or late completions and lowered again after ISOC_ADAPT_QUIET ms
+ * without. The new depth is used for the next resubmit of the URB.
+ * The completing URB was submitted with the old depth, so packets and
+ * not iso_packets give the expected time since the last completion.
+ */
+static void
+adapt_iso_depth(usb_fifo * fifo, int packets, int errors)
+{
+	ktime_t		now = ktime_get();
+	u64		lat;
+	int		bad = errors;
+
+	fifo->stat.urbs++;
+	fifo->stat.errors += errors;
+	if (ktime_to_ns(fifo->iso_stamp)) {
+		lat = ktime_to_ns(ktime_sub(now, fifo->iso_stamp));
+		do_div(lat, 1000);
+		if (lat > fifo->stat.max_lat)
+			fifo->stat.max_lat = lat;
+		if (lat > (packets + 1) * 1000) {
+			fifo->stat.late++;
+			bad++;
+		}
+	}
+	fifo->iso_stamp = now;
+
+	if (!iso_adapt)
+		return;
+	if (bad) {
+		fifo->iso_quiet = 0;
+		if (fifo->iso_packets < fifo->iso_max) {
+			fifo->iso_packets += 2;
+			if (fifo->iso_packets > fifo->iso_max)
+				fifo->iso_packets = fifo->iso_max;
+			fifo->stat.deeper++;
+		}
+	} else {
+		fifo->iso_quiet += fifo->iso_packets;
+		if (fifo->iso_quiet >= ISOC_ADAPT_QUIET) {
+			fifo->iso_quiet = 0;
+			if (fifo->iso_packets > ISOC_PACKETS_MIN) {
+				fifo->iso_packets--;
+				fifo->stat.shallower++;
+			}
+		}
+	}
+}
+
 /* receive completion routine for all ISO tx fifos   */
 static void
 #ifdef	OLD_IRQ_CALL
@@ -1142,7 +1244,7 @@ rx_iso_complete(struct urb *urb)
 	hfcsusb_t *card = fifo->card;
 	channel_t *ch = &card->chan[fifo->ch_idx];
 	int k, len, errcode, offset, num_isoc_packets, fifon, maxlen,
-	    status, iso_status;
+	    status, iso_status, errors = 0;
 	__u8 *buf;
 	static __u8 eof[8];
 
@@ -1165,7 +1267,8 @@ rx_iso_complete(struct urb *urb)
 	}
 
 	if (fifo->active && !status) {
-		num_isoc_packets = iso_packets[fifon];
+		/* the depth may have changed since this URB was submitted */
+		num_isoc_packets = urb->number_of_packets;
 		maxlen = fifo->usb_packet_maxlen;
 
 		for (k = 0; k < num_isoc_packets; ++k)
@@ -1174,6 +1277,8 @@ rx_iso_complete(struct urb *urb)
 			offset = urb->iso_frame_desc[k].offset;
 			buf = context_iso_urb->buffer + offset;
 			iso_status = urb->iso_frame_desc[k].status;
+			if (iso_status)
+				errors++;
 
 			if (ch->debug && iso_status && !card->disc_flag)
 				printk(KERN_INFO
@@ -1216,9 +1321,12 @@ rx_iso_complete(struct urb *urb)
 			}
 			fifo->last_urblen = len;
 		}
+		/* all D-channel frames of this URB in one message */
+		flush_ch_frames(ch);
 
+		adapt_iso_depth(fifo, urb->number_of_packets, errors);
 		fill_isoc_urb(urb, fifo->card->dev, fifo->pipe,
-			      context_iso_urb->buffer, num_isoc_packets,
+			      context_iso_urb->buffer, fifo->iso_packets,
 			      fifo->usb_packet_maxlen, fifo->intervall,
 			      (usb_complete_t)rx_iso_complete, urb->context);
 		errcode = usb_submit_urb(urb, GFP_ATOMIC);
@@ -1299,6 +1407,7 @@ rx_int_complete(struct urb *urb)
 		collect_rx_frame(fifo, buf, urb->actual_length,
 				 (len < maxlen) ? eof[fifon] : 0);
 	}
+	flush_ch_frames(ch);
 	fifo->last_urblen = urb->actual_length;
 
 	status = usb_submit_urb(urb, GFP_ATOMIC);
@@ -1369,7 +1478,7 @@ tx_iso_complete(struct urb *urb)
 	hfcsusb_t *card = fifo->card;
 	channel_t *ch = &card->chan[fifo->ch_idx];
 	int k, tx_offset, num_isoc_packets, sink, remain, current_len,
-	    errcode;
+	    errcode, errors = 0;
 	int frame_complete, fifon, status;
 	__u8 threshbit;
 
@@ -1389,14 +1498,16 @@ tx_iso_complete(struct urb *urb)
 				"urb->status %d, fifonum %d\n",
 				status, fifon);
 
-		if (ch->debug) {
-			for (k = 0; k < iso_packets[fifon]; ++k) {
-				errcode = urb->iso_frame_desc[k].status;
+		for (k = 0; k < urb->number_of_packets; ++k) {
+			errcode = urb->iso_frame_desc[k].status;
+			if (!errcode)
+				continue;
+			errors++;
+			if (ch->debug)
 				printk(KERN_INFO
 				       "HFC-S USB: tx_iso_complete with -EXDEV, "
 				       "ISO packet %i, status: %i\n",
 				       k, errcode);
-			}
 		}
 
 		// clear status, so go on with ISO transfers
@@ -1406,7 +1517,8 @@ tx_iso_complete(struct urb *urb)
 	if (fifo->active && !status) {
 		/* is FifoFull-threshold set for our channel? */
 		threshbit = (card->threshold_mask & (1 << fifon));
-		num_isoc_packets = iso_packets[fifon];
+		adapt_iso_depth(fifo, urb->number_of_packets, errors);
+		num_isoc_packets = fifo->iso_packets;
 
 		/* predict dataflow to avoid fifo overflow */
 		if (fifon >= HFCUSB_D_TX) {
@@ -1480,7 +1592,12 @@ tx_iso_complete(struct urb *urb)
 #endif
 
 				tx_offset += (current_len + 1);
+				fifo->tx_data = 1;
 			} else {
+				/* gap in a transparent data stream */
+				if (fifo->tx_data && !test_bit(FLG_HDLC, &ch->Flags))
+					fifo->stat.underruns++;
+				fifo->tx_data = 0;
 				urb->iso_frame_desc[k].offset = tx_offset++;
 
 				urb->iso_frame_desc[k].length = 1;
@@ -1536,15 +1653,33 @@ start_isoc_chain(usb_fifo * fifo, int num_packets_per_urb,
 {
 	int i, k, errcode;
 
+	/* URB depth may change at runtime, see adapt_iso_depth() */
+	fifo->iso_max = ISOC_PACKETS_MAX;
+	if (fifo->usb_packet_maxlen)
+		fifo->iso_max = ISO_BUFFER_SIZE / fifo->usb_packet_maxlen;
+	if (fifo->iso_max > ISOC_PACKETS_MAX)
+		fifo->iso_max = ISOC_PACKETS_MAX;
+	if (iso_depth)
+		num_packets_per_urb = iso_depth;
+	if (num_packets_per_urb < ISOC_PACKETS_MIN)
+		num_packets_per_urb = ISOC_PACKETS_MIN;
+	if (num_packets_per_urb > fifo->iso_max)
+		num_packets_per_urb = fifo->iso_max;
+	fifo->iso_packets = num_packets_per_urb;
+	fifo->iso_quiet = 0;
+	fifo->tx_data = 0;
+	fifo->iso_stamp = ktime_set(0, 0);
+	memset(&fifo->stat, 0, sizeof(fifo->stat));
+
 	if (debug)
-		printk(KERN_INFO "HFC-S USB: starting ISO-chain for Fifo %i\n",
-		       fifo->fifonum);
+		printk(KERN_INFO "HFC-S USB: starting ISO-chain for Fifo %i (%i packets)\n",
+		       fifo->fifonum, num_packets_per_urb);
 
 	/* allocate Memory for Iso out Urbs */
 	for (i = 0; i < 2; i++) {
 		if (!(fifo->iso[i].purb)) {
 			fifo->iso[i].purb =
-			    usb_alloc_urb(num_packets_per_urb, GFP_KERNEL);
+			    usb_alloc_urb(ISOC_PACKETS_MAX, GFP_KERNEL);
 			if (!(fifo->iso[i].purb)) {
 				printk(KERN_INFO
 				       "alloc urb for fifo %i failed!!!",
@@ -1821,6 +1956,38 @@ setup_hfcsusb(hfcsusb_t * card)
 	return (0);
 }
 
+/* ISO statistics in sysfs */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,13)
+static ssize_t
+show_iso_stat(struct device *dev, struct device_attribute *attr, char *buf)
+#else
+static ssize_t
+show_iso_stat(struct device *dev, char *buf)
+#endif
+{
+	hfcsusb_t	*card = dev_get_drvdata(dev);
+	usb_fifo	*fifo;
+	char		*p = buf;
+	int		i;
+
+	if (!card)
+		return(-ENODEV);
+	for (i = 0; i < HFCUSB_NUM_FIFOS; i++) {
+		fifo = &card->fifos[i];
+		if (fifo->usb_transfer_mode != USB_ISOC || !fifo->active)
+			continue;
+		p += sprintf(p, "fifo %d: packets %d urbs %lu errors %lu "
+			"underruns %lu late %lu max_lat %lu deeper %lu "
+			"shallower %lu\n", i, fifo->iso_packets,
+			fifo->stat.urbs, fifo->stat.errors,
+			fifo->stat.underruns, fifo->stat.late,
+			fifo->stat.max_lat, fifo->stat.deeper,
+			fifo->stat.shallower);
+	}
+	return(p - buf);
+}
+static DEVICE_ATTR(iso_stat, S_IRUGO, show_iso_stat, NULL);
+
 static void
 release_card(hfcsusb_t * card)
 {
@@ -1868,8 +2035,11 @@ release_card(hfcsusb_t * card)
 		card->ctrl_urb = NULL;
 	}
 	hfcsusb_cnt--;
-	if (card->intf)
+	if (card->intf) {
+		if (!card->disc_flag)
+			device_remove_file(&card->intf->dev, &dev_attr_iso_stat);
 		usb_set_intfdata(card->intf, NULL);
+	}
 	kfree(card);
 }
 
@@ -1910,6 +2080,7 @@ setup_instance(hfcsusb_t * card)
         card->chan[D].inst.class_dev.dev = &card->dev->dev;
 #endif
 	mISDN_init_instance(&card->chan[D].inst, &hw_mISDNObj, card, hfcsusb_l2l1);
+	card->chan[D].inst.extentions |= EXT_INST_DCHAIN;
 	sprintf(card->chan[D].inst.name, "hfcsusb_%d", hfcsusb_cnt + 1);
 	mISDN_set_dchannel_pid(&pid, protocol[hfcsusb_cnt], layermask[hfcsusb_cnt]);
 	mISDN_initchannel(&card->chan[D], MSK_INIT_DCHANNEL, MAX_DFRAME_LEN_L1);
@@ -2006,6 +2177,8 @@ setup_instance(hfcsusb_t * card)
 
 	mISDN_ctrl(card->chan[D].inst.st, MGR_CTRLREADY | INDICATION, NULL);
 	usb_set_intfdata(card->intf, card);
+	if (device_create_file(&card->intf->dev, &dev_attr_iso_stat))
+		printk(KERN_WARNING "HFC-S USB: cannot create iso_stat attribute\n");
 	return (0);
 }
 
@@ -2217,6 +2390,7 @@ hfcsusb_disconnect(struct usb_interface *intf)
 	if (debug & 0x10000)
 		printk(KERN_DEBUG "%s\n", __FUNCTION__);
 	card->disc_flag = 1;
+	device_remove_file(&intf->dev, &dev_attr_iso_stat);
 	mISDN_ctrl(card->chan[D].inst.st, MGR_DELSTACK | REQUEST, NULL);
 //	release_card(card);
 	usb_set_intfdata(intf, NULL);
@@ -94,15 +94,15 @@
 #define USB_BULK	1
 #define USB_ISOC	2
 
+/* default number of ISO packets (1 ms each) handled in one URB */
 #define ISOC_PACKETS_D	8
 #define ISOC_PACKETS_B	8
-#define ISO_BUFFER_SIZE	128
-
-/* defines how much ISO packets are handled in one URB */
-static int iso_packets[8] =
-    { ISOC_PACKETS_B, ISOC_PACKETS_B, ISOC_PACKETS_B, ISOC_PACKETS_B,
-	ISOC_PACKETS_D, ISOC_PACKETS_D, ISOC_PACKETS_D, ISOC_PACKETS_D
-};
+/* range for iso_depth and the adaptive URB depth */
+#define ISOC_PACKETS_MIN	2
+#define ISOC_PACKETS_MAX	16
+#define ISO_BUFFER_SIZE	(ISOC_PACKETS_MAX * 16)
+/* ms without ISO errors before the URB depth is lowered by one packet */
+#define ISOC_ADAPT_QUIET	2000
 
 
 /* Fifo flow Control for TX ISO */
@@ -1547,6 +1547,7 @@ I4Lcapi_init(void)
 	i4lfsm_s.event_count = EVENT_COUNT;
 	i4lfsm_s.strEvent = strI4LEvent;
 	i4lfsm_s.strState = strI4LState;
+	i4lfsm_s.name = "i4l";
 	mISDN_FsmNew(&i4lfsm_s, I4LFnList, I4L_FN_COUNT);
 	if ((err = mISDN_register(&I4Lcapi))) {
 		printk(KERN_ERR "Can't register I4L CAPI error(%d)\n", err);
@@ -0,0 +1,151 @@
+/*
+ * irq_bh.c: common bottom half for the interrupt work of the card drivers
+ *
+ * All pending cards are kept in one list, the tasklet calls the work
+ * function of the first card and queues it again at the tail, if it
+ * did use up its budget, so a busy card cannot starve the other cards
+ * on the same (shared) interrupt line.
+ * There is only one tasklet, so the work of all cards is serialized on
+ * one CPU at a time; the drivers use it only with irq_bh=1.
+ *
+ * This file is (c) under GNU PUBLIC LICENSE
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include "irq_bh.h"
+
+/* max work calls in one tasklet run, the rest is done in the next run */
+#define MISDN_BH_MAXRUNS	32
+
+static LIST_HEAD(bh_pending);
+static LIST_HEAD(bh_all);
+static DEFINE_SPINLOCK(bh_lock);
+
+static void irq_bh_run(unsigned long);
+static DECLARE_TASKLET(bh_tasklet, irq_bh_run, 0);
+
+static void
+irq_bh_run(unsigned long data)
+{
+	mISDN_irq_bh_t	*bh;
+	u_long		flags;
+	cycles_t	start;
+	int		cnt = 0, done;
+
+	spin_lock_irqsave(&bh_lock, flags);
+	while (!list_empty(&bh_pending)) {
+		if (cnt++ >= MISDN_BH_MAXRUNS) {
+			tasklet_schedule(&bh_tasklet);
+			break;
+		}
+		bh = list_entry(bh_pending.next, mISDN_irq_bh_t, list);
+		list_del_init(&bh->list);
+		/* new interrupts from now on need a new run */
+		clear_bit(MISDN_BH_PENDING, &bh->flags);
+		spin_unlock_irqrestore(&bh_lock, flags);
+		start = get_cycles();
+		done = bh->work(bh, bh->budget);
+		bh->bh_cycles += get_cycles() - start;
+		bh->runs++;
+		if (done >= bh->budget) {
+			bh->exhausted++;
+			mISDN_irq_bh_schedule(bh);
+		}
+		spin_lock_irqsave(&bh_lock, flags);
+	}
+	spin_unlock_irqrestore(&bh_lock, flags);
+}
+
+void
+mISDN_irq_bh_init(mISDN_irq_bh_t *bh, char *name, mISDN_bh_work_t work,
+	void *priv, int budget)
+{
+	u_long	flags;
+
+	memset(bh, 0, sizeof(mISDN_irq_bh_t));
+	INIT_LIST_HEAD(&bh->list);
+	bh->name = name;
+	bh->work = work;
+	bh->priv = priv;
+	bh->budget = budget > 0 ? budget : MISDN_BH_BUDGET;
+	spin_lock_irqsave(&bh_lock, flags);
+	list_add_tail(&bh->all, &bh_all);
+	spin_unlock_irqrestore(&bh_lock, flags);
+}
+
+/* may be called from the hardirq handler */
+void
+mISDN_irq_bh_schedule(mISDN_irq_bh_t *bh)
+{
+	u_long	flags;
+	int	sched = 0;
+
+	spin_lock_irqsave(&bh_lock, flags);
+	if (!test_bit(MISDN_BH_DEAD, &bh->flags) &&
+		!test_and_set_bit(MISDN_BH_PENDING, &bh->flags)) {
+		list_add_tail(&bh->list, &bh_pending);
+		sched = 1;
+	}
+	spin_unlock_irqrestore(&bh_lock, flags);
+	if (sched)
+		tasklet_schedule(&bh_tasklet);
+}
+
+/*
+ * after this call the work function is not running and will not be
+ * called again, later mISDN_irq_bh_schedule() calls are ignored
+ */
+void
+mISDN_irq_bh_kill(mISDN_irq_bh_t *bh)
+{
+	u_long	flags;
+
+	spin_lock_irqsave(&bh_lock, flags);
+	set_bit(MISDN_BH_DEAD, &bh->flags);
+	spin_unlock_irqrestore(&bh_lock, flags);
+	/* wait for a running work function */
+	tasklet_disable(&bh_tasklet);
+	spin_lock_irqsave(&bh_lock, flags);
+	if (test_and_clear_bit(MISDN_BH_PENDING, &bh->flags))
+		list_del_init(&bh->list);
+	list_del(&bh->all);
+	spin_unlock_irqrestore(&bh_lock, flags);
+	tasklet_enable(&bh_tasklet);
+}
+
+/* one line per card */
+ssize_t
+mISDN_irq_bh_show(char *buf, size_t size)
+{
+	mISDN_irq_bh_t	*bh;
+	char		*p = buf;
+	u_long		flags;
+
+	spin_lock_irqsave(&bh_lock, flags);
+	list_for_each_entry(bh, &bh_all, all) {
+		if ((p - buf) + 160 > size)
+			break;
+		p += sprintf(p, "%s irqs %lu irq_cycles %llu runs %lu "
+			"bh_cycles %llu exhausted %lu budget %d\n",
+			bh->name ? bh->name : "card", bh->irqs, bh->irq_cycles,
+			bh->runs, bh->bh_cycles, bh->exhausted, bh->budget);
+	}
+	spin_unlock_irqrestore(&bh_lock, flags);
+	return(p - buf);
+}
+
+void
+mISDN_irq_bh_cleanup(void)
+{
+	if (!list_empty(&bh_all))
+		printk(KERN_WARNING "mISDN: irq bottom half list not empty\n");
+	tasklet_kill(&bh_tasklet);
+}
+
+EXPORT_SYMBOL(mISDN_irq_bh_init);
+EXPORT_SYMBOL(mISDN_irq_bh_schedule);
+EXPORT_SYMBOL(mISDN_irq_bh_kill);
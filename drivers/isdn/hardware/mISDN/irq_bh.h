@@ -0,0 +1,69 @@
+/*
+ * irq_bh.h: common bottom half for the interrupt work of the card drivers
+ *
+ * The hardirq handler of a card only acknowledges the interrupt, saves the
+ * status and calls mISDN_irq_bh_schedule(). The FIFO work is done later in
+ * the work function of the card, called from one tasklet for all cards.
+ * Each call may handle up to budget work units (driver defined), a card
+ * which used up its budget is queued again behind the other pending cards.
+ *
+ * This file is (c) under GNU PUBLIC LICENSE
+ *
+ */
+
+#ifndef _MISDN_IRQ_BH_H
+#define _MISDN_IRQ_BH_H
+
+#include <linux/list.h>
+#include <asm/timex.h>
+
+/* flags */
+#define MISDN_BH_PENDING	0
+#define MISDN_BH_DEAD		1
+
+#define MISDN_BH_BUDGET		8
+
+typedef struct _mISDN_irq_bh mISDN_irq_bh_t;
+
+/* returns the count of done work units, budget means more work pending */
+typedef int (*mISDN_bh_work_t)(mISDN_irq_bh_t *, int);
+
+struct _mISDN_irq_bh {
+	struct list_head	list;	/* pending list */
+	struct list_head	all;	/* all registered, for statistics */
+	char			*name;
+	mISDN_bh_work_t		work;
+	void			*priv;
+	int			budget;
+	u_long			flags;
+	/* accounting, times in get_cycles() units */
+	cycles_t		irq_start;
+	u_long			irqs;
+	unsigned long long	irq_cycles;
+	u_long			runs;
+	u_long			exhausted;
+	unsigned long long	bh_cycles;
+};
+
+/* call at begin and end of the hardirq handler for time in IRQ accounting */
+static inline void
+mISDN_irq_bh_enter(mISDN_irq_bh_t *bh)
+{
+	bh->irq_start = get_cycles();
+}
+
+static inline void
+mISDN_irq_bh_leave(mISDN_irq_bh_t *bh)
+{
+	bh->irqs++;
+	bh->irq_cycles += get_cycles() - bh->irq_start;
+}
+
+extern void	mISDN_irq_bh_init(mISDN_irq_bh_t *, char *, mISDN_bh_work_t,
+			void *, int);
+extern void	mISDN_irq_bh_schedule(mISDN_irq_bh_t *);
+extern void	mISDN_irq_bh_kill(mISDN_irq_bh_t *);
+extern ssize_t	mISDN_irq_bh_show(char *, size_t);
+extern void	mISDN_irq_bh_cleanup(void);
+
+#endif
@@ -500,8 +500,8 @@ isacsx_rme_irq(channel_t *dch)
 	dch->rx_skb = NULL;
 }
 
-void
-mISDN_isac_interrupt(channel_t *dch, u_char val)
+static void
+isac_irq_events(channel_t *dch, u_char val)
 {
 	if (dch->debug & L1_DEB_ISAC)
 		mISDN_debugprint(&dch->inst, "ISAC interrupt %02x", val);
@@ -575,6 +575,26 @@ mISDN_isac_interrupt(channel_t *dch, u_char val)
 	}
 }
 
+/*
+ * Events which came in while the last ones were handled (e.g. RME after
+ * RPF of a long frame or XPR after the FIFO was filled) are handled in
+ * the same call, so they do not need an own interrupt.
+ */
+void
+mISDN_isac_interrupt(channel_t *dch, u_char val)
+{
+	u_char	ista;
+	int	cnt = ISAC_IRQ_LOOPS;
+
+	ista = (dch->type & ISAC_TYPE_ISACSX) ? ISACSX_ISTA : ISAC_ISTA;
+	while (val) {
+		isac_irq_events(dch, val);
+		if (!--cnt)
+			break;
+		val = dch->read_reg(dch->inst.privat, ista);
+	}
+}
+
 int
 mISDN_ISAC_l1hw(mISDNinstance_t *inst, struct sk_buff *skb)
 {
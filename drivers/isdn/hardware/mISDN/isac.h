@@ -131,6 +131,9 @@ typedef struct isac_chip {
 extern int mISDN_isac_init(channel_t *);
 extern void mISDN_isac_free(channel_t *);
 
+/* max ISTA reads in one mISDN_isac_interrupt() call */
+#define ISAC_IRQ_LOOPS	4
+
 extern void mISDN_isac_interrupt(channel_t *, u_char);
 extern void mISDN_clear_isac(channel_t *);
 extern int mISDN_ISAC_l1hw(mISDNinstance_t *, struct sk_buff *);
@@ -184,7 +184,8 @@ void mISDN_AddIE(struct sk_buff *skb, u_char ie, u_char *iep)
 	p = skb_put(skb, l+1);
 	ies->off = (u16)(p - ps);
 	*p++ = ie;
-	if (l)
+	/* the content may be encoded in place already */
+	if (l && (p != iep))
 		memcpy(p, iep, l);
 }
 
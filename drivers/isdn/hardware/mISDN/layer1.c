@@ -519,9 +519,6 @@ l1from_up(layer1_t *l1, struct sk_buff *skb, mISDN_head_t *hh)
 				mISDN_FsmEvent(&l1->l1m, EV_PH_ACTIVATE, NULL);
 			}
 			break;
-		case (MDL_FINDTEI | REQUEST):
-			return(mISDN_queue_up(&l1->inst, 0, skb));
-			break;
 		default:
 			if (l1->debug)
 				mISDN_debug(l1->inst.st->id, NULL,
@@ -539,7 +536,7 @@ l1from_down(layer1_t *l1, struct sk_buff *skb, mISDN_head_t *hh)
 {
 	int		err = 0;
 
-	if (hh->prim == PH_DATA_IND) {
+	if ((hh->prim == PH_DATA_IND) || (hh->prim == PH_DATA_CHAIN_IND)) {
 		if (test_bit(FLG_L1_ACTTIMER, &l1->Flags))
 			mISDN_FsmEvent(&l1->l1m, EV_TIMER_ACT, NULL);
 		return(mISDN_queue_up(&l1->inst, 0, skb));
@@ -678,6 +675,8 @@ new_l1(mISDNstack_t *st, mISDN_pid_t *pid) {
 	memset(nl1, 0, sizeof(layer1_t));
 	memcpy(&nl1->inst.pid, pid, sizeof(mISDN_pid_t));
 	mISDN_init_instance(&nl1->inst, &isdnl1, nl1, l1_function);
+	/* PH_DATA_CHAIN_IND and HW_D_CHAIN_ON are passed through */
+	nl1->inst.extentions = EXT_INST_DCHAIN;
 	if (!mISDN_SetHandledPID(&isdnl1, &nl1->inst.pid)) {
 		int_error();
 		return(-ENOPROTOOPT);
@@ -829,18 +828,21 @@ int Isdnl1Init(void)
 	l1fsm_u.event_count = L1_EVENT_COUNT;
 	l1fsm_u.strEvent = strL1Event;
 	l1fsm_u.strState = strL1UState;
+	l1fsm_u.name = "l1_user";
 	mISDN_FsmNew(&l1fsm_u, L1UFnList, L1U_FN_COUNT);
 #endif
 	l1fsm_s.state_count = L1S_STATE_COUNT;
 	l1fsm_s.event_count = L1_EVENT_COUNT;
 	l1fsm_s.strEvent = strL1Event;
 	l1fsm_s.strState = strL1SState;
+	l1fsm_s.name = "l1_net";
 	mISDN_FsmNew(&l1fsm_s, L1SFnList, L1S_FN_COUNT);
 #ifdef OBSOLETE
 	l1fsm_b.state_count = L1B_STATE_COUNT;
 	l1fsm_b.event_count = L1_EVENT_COUNT;
 	l1fsm_b.strEvent = strL1Event;
 	l1fsm_b.strState = strL1BState;
+	l1fsm_b.name = "l1_b";
 	mISDN_FsmNew(&l1fsm_b, L1BFnList, L1B_FN_COUNT);
 #endif
 	if ((err = mISDN_register(&isdnl1))) {
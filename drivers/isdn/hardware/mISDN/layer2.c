@@ -1285,7 +1285,8 @@ l2_got_iframe(struct FsmInst *fi, int event, void *arg)
 	}
 	if (skb_queue_len(&l2->i_queue) && (fi->state == ST_L2_7))
 		mISDN_FsmEvent(fi, EV_L2_ACK_PULL, NULL);
-	if (test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
+	if (!test_bit(FLG_RX_CHAIN, &l2->flag) &&
+		test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
 		enquiry_cr(l2, RR, RSP, 0);
 }
 
@@ -1296,7 +1297,7 @@ l2_got_tei(struct FsmInst *fi, int event, void *arg)
 	struct sk_buff	*skb = arg;
 	mISDN_head_t	*hh = mISDN_HEAD_P(skb);
 
-	l2->tei = hh->dinfo;
+	set_tei(l2, hh->dinfo);
 	dev_kfree_skb(skb);
 	if (fi->state == ST_L2_3) {
 		establishlink(fi);
@@ -1545,7 +1546,7 @@ l2_st24_tei_remove(struct FsmInst *fi, int event, void *arg)
 	struct sk_buff *skb = arg;
 
 	discard_queue(&l2->ui_queue);
-	l2->tei = -1;
+	set_tei(l2, -1);
 	mISDN_FsmChangeState(fi, ST_L2_1);
 	dev_kfree_skb(skb);
 }
@@ -1557,7 +1558,7 @@ l2_st3_tei_remove(struct FsmInst *fi, int event, void *arg)
 	struct sk_buff *skb = arg;
 
 	discard_queue(&l2->ui_queue);
-	l2->tei = -1;
+	set_tei(l2, -1);
 	skb_trim(skb, 0);
 	if (l2up(l2, DL_RELEASE | INDICATION, 0, skb))
 		dev_kfree_skb(skb);
@@ -1573,7 +1574,7 @@ l2_st5_tei_remove(struct FsmInst *fi, int event, void *arg)
 	discard_queue(&l2->i_queue);
 	discard_queue(&l2->ui_queue);
 	freewin(l2);
-	l2->tei = -1;
+	set_tei(l2, -1);
 	stop_t200(l2, 17);
 	st5_dl_release_l2l3(l2);
 	mISDN_FsmChangeState(fi, ST_L2_1);
@@ -1587,7 +1588,7 @@ l2_st6_tei_remove(struct FsmInst *fi, int event, void *arg)
 	struct sk_buff *skb = arg;
 
 	discard_queue(&l2->ui_queue);
-	l2->tei = -1;
+	set_tei(l2, -1);
 	stop_t200(l2, 18);
 	if (l2up(l2, DL_RELEASE | CONFIRM, 0, skb))
 		dev_kfree_skb(skb);
@@ -1603,7 +1604,7 @@ l2_tei_remove(struct FsmInst *fi, int event, void *arg)
 	discard_queue(&l2->i_queue);
 	discard_queue(&l2->ui_queue);
 	freewin(l2);
-	l2->tei = -1;
+	set_tei(l2, -1);
 	stop_t200(l2, 17);
 	mISDN_FsmDelTimer(&l2->t203, 19);
 	if (l2up(l2, DL_RELEASE | INDICATION, 0, skb))
@@ -1893,6 +1894,49 @@ ph_data_indication(layer2_t *l2, mISDN_head_t *hh, struct sk_buff *skb) {
 	return(ret);
 }
 
+/*
+ * several frames received by layer1 in one go, the acknowledge for
+ * the I-frames is sent once after the whole chain was processed
+ */
+static int
+ph_data_chain_indication(layer2_t *l2, mISDN_head_t *hh, struct sk_buff *skb) {
+	struct sk_buff_head	fq;
+	struct sk_buff		*nskb;
+	u_int			addr = hh->addr;
+
+	skb_queue_head_init(&fq);
+	mISDN_unchain_skb(skb, &fq);
+	test_and_set_bit(FLG_RX_CHAIN, &l2->flag);
+	while ((nskb = __skb_dequeue(&fq))) {
+		mISDN_sethead(PH_DATA_IND, MISDN_ID_ANY, nskb);
+		mISDN_HEAD_P(nskb)->addr = addr;
+		if (ph_data_indication(l2, mISDN_HEAD_P(nskb), nskb))
+			dev_kfree_skb(nskb);
+	}
+	test_and_clear_bit(FLG_RX_CHAIN, &l2->flag);
+	if (((l2->l2m.state == ST_L2_7) || (l2->l2m.state == ST_L2_8)) &&
+		test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
+		enquiry_cr(l2, RR, RSP, 0);
+	return(0);
+}
+
+/* all instances below us have to know PH_DATA_CHAIN_IND */
+static int
+l1_can_chain(layer2_t *l2)
+{
+	mISDNstack_t	*st = l2->inst.st;
+	int		i;
+
+	if (!st)
+		return(0);
+	for (i = 0; i < (l2->inst.id & LAYER_ID_MASK); i++) {
+		if (!st->i_array[i] ||
+			!(st->i_array[i]->extentions & EXT_INST_DCHAIN))
+			return(0);
+	}
+	return(i > 0);
+}
+
 static int
 l2from_down(layer2_t *l2, struct sk_buff *askb, mISDN_head_t *hh)
 {
@@ -1902,25 +1946,6 @@ l2from_down(layer2_t *l2, struct sk_buff *askb, mISDN_head_t *hh)
 //	printk(KERN_DEBUG "%s: prim(%x)\n", __FUNCTION__, hh->prim);
 	if (hh->prim == (PH_DATA | CONFIRM))
 		return(ph_data_confirm(&l2->inst, hh, askb));
-	if (hh->prim == (MDL_FINDTEI | REQUEST)) {
-		ret = -ESRCH;
-		if (test_bit(FLG_LAPD, &l2->flag)) {
-			if (l2->tei == hh->dinfo) {
-				void *p = ((u_char *)askb->data);
-				teimgr_t **tp = p;
-				if (tp) {
-					*tp = l2->tm;
-					dev_kfree_skb(askb);
-					return(0);
-				}
-			}
-		}
-#ifdef FIXME
-		if (next && next->func)
-			ret = next->func(next, askb);
-#endif
-		return(ret);
-	}
 #ifdef FIXME
 	if (next) {
 		if (next->func) {
@@ -1935,6 +1960,9 @@ l2from_down(layer2_t *l2, struct sk_buff *askb, mISDN_head_t *hh)
 		case (PH_DATA_IND):
 			ret = ph_data_indication(l2, hh, cskb);
 			break;
+		case (PH_DATA_CHAIN_IND):
+			ret = ph_data_chain_indication(l2, hh, cskb);
+			break;
 		case (PH_CONTROL | INDICATION):
 			if (hh->dinfo == HW_D_BLOCKED)
 				test_and_set_bit(FLG_DCHAN_BUSY, &l2->flag);
@@ -1946,6 +1974,15 @@ l2from_down(layer2_t *l2, struct sk_buff *askb, mISDN_head_t *hh)
 		case (PH_ACTIVATE | CONFIRM):
 		case (PH_ACTIVATE | INDICATION):
 			test_and_set_bit(FLG_L1_ACTIV, &l2->flag);
+			/*
+			 * we can handle PH_DATA_CHAIN_IND; layer1 forgets it on
+			 * reset and deactivation, so ask on every activation
+			 */
+			if (test_bit(FLG_LAPD, &l2->flag) && l1_can_chain(l2)) {
+				test_and_set_bit(FLG_CHAIN_REQ, &l2->flag);
+				l2down_create(l2, PH_CONTROL | REQUEST,
+					HW_D_CHAIN_ON, 0, NULL);
+			}
 			if (test_and_clear_bit(FLG_ESTAB_PEND, &l2->flag)) 
 				ret = mISDN_FsmEvent(&l2->l2m, EV_L2_DL_ESTABLISH_REQ, cskb);
 			break;
@@ -2121,9 +2158,6 @@ tei_l2(layer2_t *l2, struct sk_buff *skb)
 		printk(KERN_NOTICE "MDL_ERROR|REQ (tei_l2)\n");
 		ret = mISDN_FsmEvent(&l2->l2m, EV_L2_MDL_ERROR, skb);
 		break;
-	    case (MDL_FINDTEI | REQUEST):
-	    	ret = l2down_skb(l2, skb);
-		break;
 	}
 	return(ret);
 }
@@ -2153,6 +2187,9 @@ release_l2(layer2_t *l2)
 	discard_queue(&l2->ui_queue);
 	discard_queue(&l2->down_queue);
 	ReleaseWin(l2);
+	/* the next layer above layer1 may not know PH_DATA_CHAIN_IND */
+	if (test_and_clear_bit(FLG_CHAIN_REQ, &l2->flag))
+		l2down_create(l2, PH_CONTROL | REQUEST, HW_D_CHAIN_OFF, 0, NULL);
 	if (test_bit(FLG_LAPD, &l2->flag))
 		release_tei(l2->tm);
 #ifdef OBSOLETE
@@ -2225,7 +2262,7 @@ new_l2(mISDNstack_t *st, mISDN_pid_t *pid) {
 		nl2->T200 = 1000;
 		nl2->N200 = 3;
 		nl2->T203 = 10000;
-		if (create_teimgr(nl2)) {
+		if (create_teimgr(nl2, st)) {
 			kfree(nl2);
 			return(-EINVAL);
 		}
@@ -2258,7 +2295,7 @@ new_l2(mISDNstack_t *st, mISDN_pid_t *pid) {
 		nl2->T200 = 1000;
 		nl2->N200 = 3;
 		nl2->T203 = 10000;
-		if (create_teimgr(nl2)) {
+		if (create_teimgr(nl2, st)) {
 			kfree(nl2);
 			return(-EINVAL);
 		}
@@ -2326,6 +2363,8 @@ new_l2(mISDNstack_t *st, mISDN_pid_t *pid) {
 	if (err) {
 		mISDN_FsmDelTimer(&nl2->t200, 0);
 		mISDN_FsmDelTimer(&nl2->t203, 0);
+		if (nl2->tm)
+			release_tei(nl2->tm);
 		list_del(&nl2->list);
 		kfree(nl2);
 		nl2 = NULL;
@@ -2525,6 +2564,7 @@ int Isdnl2_Init(void)
 	l2fsm.event_count = L2_EVENT_COUNT;
 	l2fsm.strEvent = strL2Event;
 	l2fsm.strState = strL2State;
+	l2fsm.name = "l2";
 	mISDN_FsmNew(&l2fsm, L2FnList, L2_FN_COUNT);
 	TEIInit();
 	if ((err = mISDN_register(&isdnl2))) {
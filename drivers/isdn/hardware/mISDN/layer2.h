@@ -14,14 +14,33 @@
 #endif
 
 #define MAX_WINDOW	8
+#define TEI_TABLE_SIZE	127	/* TEI 0..126, 127 is the group TEI */
+
+/*
+ * one TEI table per D-channel, shared by all layer2 instances
+ * on the master stack and its clones, indexed by the assigned TEI
+ */
+typedef struct _teitab {
+	struct list_head	list;
+	void			*key;
+	int			refcnt;
+	spinlock_t		lock;
+	struct _layer2		*l2[TEI_TABLE_SIZE];
+	struct timer_list	t202;
+	spinlock_t		t202_lock;	/* held while T202 runs a manager */
+	struct list_head	t202_list;
+} teitab_t;
 
 typedef struct _teimgr {
 	int		ri;
 	struct FsmInst	tei_m;
-	struct FsmTimer	t202;
+	struct list_head	t202_list;
+	u_long		t202_expires;
 	int		T202, N202;
 	int		debug;
 	struct _layer2	*l2;
+	mISDNstack_t	*st;
+	teitab_t	*tt;
 } teimgr_t;
 
 typedef struct _laddr {
@@ -93,8 +112,9 @@ extern int tei_l2(layer2_t *l2, struct sk_buff *skb);
 
 /* from tei.c */
 extern int l2_tei(teimgr_t *tm, struct sk_buff *skb);
-extern int create_teimgr(layer2_t *l2);
+extern int create_teimgr(layer2_t *l2, mISDNstack_t *st);
 extern void release_tei(teimgr_t *tm);
+extern void set_tei(layer2_t *l2, int tei);
 extern int TEIInit(void);
 extern void TEIFree(void);
 
@@ -138,3 +158,5 @@ extern void TEIFree(void);
 #define FLG_L2BLOCK	16
 #define FLG_L1_BUSY	17
 #define FLG_LAPD_NET	18
+#define FLG_RX_CHAIN	19
+#define FLG_CHAIN_REQ	20
@@ -595,6 +595,7 @@ mISDNl3New(void)
 	l3fsm.event_count = L3_EVENT_COUNT;
 	l3fsm.strEvent = strL3Event;
 	l3fsm.strState = strL3State;
+	l3fsm.name = "l3";
 	mISDN_FsmNew(&l3fsm, L3FnList, L3_FN_COUNT);
 }
 
@@ -62,6 +62,24 @@ listen_debug(struct FsmInst *fi, char *fmt, ...)
 	va_end(args);
 }
 
+/* keep the listen_map of the controller in sync with the CIPmask */
+static void
+listenSetCIPmask(Application_t *app, __u32 mask)
+{
+	Controller_t	*contr = app->contr;
+	int		i;
+
+	app->CIPmask = mask;
+	if (!contr || (app->ApplId > CAPI_MAXAPPL))
+		return;
+	for (i = 0; i < CAPI_CIP_COUNT; i++) {
+		if (mask & (1 << i))
+			set_bit(app->ApplId, contr->listen_map[i]);
+		else
+			clear_bit(app->ApplId, contr->listen_map[i]);
+	}
+}
+
 static void
 listen_req_l_x(struct FsmInst *fi, int event, void *arg, int state)
 {
@@ -71,7 +89,7 @@ listen_req_l_x(struct FsmInst *fi, int event, void *arg, int state)
 	mISDN_FsmChangeState(fi, state);
 
 	app->InfoMask = cmsg->InfoMask;
-	app->CIPmask = cmsg->CIPmask;
+	listenSetCIPmask(app, cmsg->CIPmask);
 	app->CIPmask2 = cmsg->CIPmask2;
 	listenDebug(app, CAPI_DBG_LISTEN_INFO, "set InfoMask to 0x%x", app->InfoMask);
 	listenDebug(app, CAPI_DBG_LISTEN_INFO, "set CIP to 0x%x,0x%x", app->CIPmask,
@@ -156,6 +174,7 @@ void listenConstr(Application_t *app)
 void listenDestr(Application_t *app)
 {
 	test_and_clear_bit(APPL_STATE_LISTEN, &app->state);
+	listenSetCIPmask(app, 0);
 	listenDebug(app, CAPI_DBG_LISTEN, "%s", __FUNCTION__);
 }
 
@@ -183,12 +202,19 @@ listenSendMessage(Application_t *app, struct sk_buff *skb)
 	return(CAPI_NOERROR);
 }
  
-int listenHandle(Application_t *app, __u16 CIPValue)
+/*
+ * map gets the ApplIds of all applications which listen to CIPValue,
+ * CIP 0 in the mask means any service
+ */
+void listenApplMap(Controller_t *contr, __u16 CIPValue, u_long *map)
 {
-	if ((app->CIPmask & 1) || 
-	    (app->CIPmask & (1 << CIPValue)))
-		return 1;
-	return 0;
+	int	i;
+
+	for (i = 0; i < CAPI_APPL_BITMAP; i++) {
+		map[i] = contr->listen_map[0][i];
+		if (CIPValue && (CIPValue < CAPI_CIP_COUNT))
+			map[i] |= contr->listen_map[CIPValue][i];
+	}
 }
 
 void init_listen(void)
@@ -197,6 +223,7 @@ void init_listen(void)
 	listen_fsm.event_count = EV_LISTEN_COUNT;
 	listen_fsm.strEvent = str_ev_listen;
 	listen_fsm.strState = str_st_listen;
+	listen_fsm.name = "listen";
 	
 	mISDN_FsmNew(&listen_fsm, fn_listen_list, FN_LISTEN_COUNT);
 }
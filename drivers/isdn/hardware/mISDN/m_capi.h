@@ -112,6 +112,7 @@ void free_ncci(void);
 
 /* we implement 64 bit extentions */
 #define CAPI_B3_DATA_IND_HEADER_SIZE	30
+#define CAPI_B3_DATA_CONF_SIZE		16
 #define CAPI_MSG_DEFAULT_LEN		256
 
 #define CAPIMSG_REQ_DATAHANDLE(m)	(m[18] | (m[19]<<8))
@@ -122,6 +123,19 @@ void free_ncci(void);
 #define CAPI_MAXPLCI_BRI		8
 #define CAPI_MAXPLCI_PRI		40
 
+#ifndef CAPI_MAXAPPL
+#define CAPI_MAXAPPL			240
+#endif
+
+/* PLCI lookup by layer3 id, must be a power of 2 */
+#define CAPI_PLCI_L3HASH		16
+#define CAPI_PLCI_L3HASH_IDX(id)	(((id) ^ ((id) >> 16)) & (CAPI_PLCI_L3HASH - 1))
+#define CAPI_PLCI_BITMAP		((CAPI_MAXPLCI_PRI + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+/* listening applications per CIP value, bit number is the ApplId */
+#define CAPI_CIP_COUNT			32
+#define CAPI_APPL_BITMAP		((CAPI_MAXAPPL + BITS_PER_LONG) / BITS_PER_LONG)
+
 __u16 q931CIPValue(Q931_info_t *);
 
 // ---------------------------------------------------------------------------
@@ -158,6 +172,8 @@ struct _ConfQueue {
 	__u32	PktId; 
 	__u16	DataHandle;
 	__u16	MsgId; 
+	__u16	Len;		/* data bytes */
+	u_long	Stamp;		/* jiffies of the DATA_B3_REQ */
 };
 
 struct Bprotocol {
@@ -185,14 +201,40 @@ struct _Controller {
 	u_int			debug;
 	int			maxplci;
 	Plci_t			*plcis;
+	u_long			plci_used[CAPI_PLCI_BITMAP];
+	Plci_t			*plci_l3hash[CAPI_PLCI_L3HASH];
+	spinlock_t		plci_lock;
 	struct list_head	Applications;
+	Application_t		*appltab[CAPI_MAXAPPL + 1];
+	u_long			listen_map[CAPI_CIP_COUNT][CAPI_APPL_BITMAP];
 	struct list_head	SSProcesse;
+	struct timer_list	ss_timer;	/* timeouts of the SSProcesse */
 	spinlock_t		list_lock;
 	__u32			NotificationMask;
 	__u16			LastInvokeId;
 	char			infobuf[128];
 };
 
+// ---------------------------------------------------------------------------
+// delayed messages
+//
+// Messages which need the B-channel stack are held in the delayedq of the
+// AppPlci until the stack is ready. Once the stack is ready, later messages
+// are queued behind them until the queue is delivered, so nothing overtakes
+// a held message. The queue is delivered in batches.
+// ---------------------------------------------------------------------------
+
+typedef struct _DelayStat {
+	u_long			msgs;		/* held messages */
+	u_long			batches;	/* delivered batches */
+	u_long			depth_max;	/* max queue length */
+	u_long			hold_sum;	/* hold time in jiffies */
+	u_long			hold_max;
+} DelayStat_t;
+
+/* enqueue time of a held message */
+#define CAPI_SKB_QTIME(skb)	(*(u_long *)(skb)->cb)
+
 // ---------------------------------------------------------------------------
 // struct Application
 // ---------------------------------------------------------------------------
@@ -211,6 +253,7 @@ struct _Application {
 	int			maxplci;
 	AppPlci_t		**AppPlcis;
 	capi_register_params	reg_params;
+	DelayStat_t		dstat;		/* sum of the AppPlcis */
 };
 
 #define APPL_STATE_ACTIV	1
@@ -227,6 +270,7 @@ struct _Plci {
 	Controller_t		*contr;
 	__u32			addr;
 	__u32			l3id;
+	Plci_t			*l3next;
 	u_long			state;
 	int			nAppl;
 	struct list_head	AppPlcis;
@@ -236,7 +280,6 @@ struct _Plci {
 #define PLCI_STATE_ALERTING	2
 #define PLCI_STATE_OUTGOING	3
 #define PLCI_STATE_STACKREADY	4
-#define PLCI_STATE_SENDDELAYED	5
 
 // ---------------------------------------------------------------------------
 // struct AppPlci
@@ -249,7 +292,9 @@ struct _AppPlci {
 	Application_t		*appl;
 	Controller_t		*contr;
 	PLInst_t		*link;
+	u_long			state;
 	struct sk_buff_head	delayedq;
+	DelayStat_t		dstat;
 	struct list_head	Nccis;
 	struct FsmInst		plci_m;
 	u_char			cause[4];
@@ -257,6 +302,37 @@ struct _AppPlci {
 	struct Bprotocol	Bprotocol;
 };
 
+#define APPLCI_STATE_SENDDELAYED	1
+
+// ---------------------------------------------------------------------------
+// NCCI data handles
+//
+// The slot of a DATA_B3_REQ is encoded in the low bits of its PktId and
+// the DataHandle of a DATA_B3_IND is the slot of the receive handle, so
+// confirm and response find the slot without a search. The used slots
+// are kept in a bitmap.
+// ---------------------------------------------------------------------------
+
+#if (CAPI_MAXDATAWINDOW & (CAPI_MAXDATAWINDOW - 1))
+#error CAPI_MAXDATAWINDOW must be a power of 2
+#endif
+
+#define NCCI_PKTID_LOCAL	0x8000	/* never set in ControllerNextId() */
+#define NCCI_PKTID_SLOT(id)	((id) & (CAPI_MAXDATAWINDOW - 1))
+
+typedef struct _NcciStat {
+	u_long			xmit;		/* DATA_B3_REQ to layer 3 */
+	u_long			xmit_max;	/* max used xmit handles */
+	u_long			sendqueuefull;	/* DATA_B3_REQ with full window */
+	u_long			recv;		/* DATA_B3_IND to application */
+	u_long			recv_max;	/* max unanswered DATA_B3_IND */
+	u_long			recv_dropped;	/* frames dropped, window full */
+	u_long			recv_copied;	/* DATA_B3_IND not sent in place */
+	u_long			qtime_sum;	/* DATA_B3_REQ to CONF in jiffies */
+	u_long			qtime_max;
+	u_long			underrun;	/* next block came after all were sent */
+} NcciStat_t;
+
 // ---------------------------------------------------------------------------
 // struct Ncci
 // ---------------------------------------------------------------------------
@@ -274,6 +350,12 @@ struct _Ncci {
 	u_long			state;
 	ConfQueue_t		xmit_skb_handles[CAPI_MAXDATAWINDOW];
 	struct sk_buff		*recv_skb_handles[CAPI_MAXDATAWINDOW];
+	u_long			xmit_busy;	/* used xmit_skb_handles */
+	u_long			recv_busy;	/* used recv_skb_handles */
+	u_int			xmit_seq;
+	int			credit;		/* bytes, 0 one block at a time */
+	int			inflight;	/* bytes below the NCCI */
+	NcciStat_t		stat;
 	struct sk_buff_head	squeue;
 };
 
@@ -294,8 +376,7 @@ struct _SSProcess {
 	__u32			addr;
 	__u16			ApplId;
 	Controller_t		*contr;
-	struct timer_list	tl;
-	__u8			buf[128];
+	u_long			expires;	/* 0 no timer, see ss_timer */
 };
 
 // ---------------------------------------------------------------------------
@@ -328,6 +409,7 @@ int		ApplicationDestr(Application_t *, int);
 void		ApplicationDebug(Application_t *appl, __u32 level, char *fmt, ...);
 void		ApplicationSendMessage(Application_t *appl, struct sk_buff *skb);
 void		SendCmsg2Application(Application_t *, _cmsg *);
+int		capi_fast_cmsg2message(_cmsg *, __u8 *);
 void		SendCmsgAnswer2Application(Application_t *, _cmsg *, __u16);
 void		AnswerMessage2Application(Application_t *, struct sk_buff *, __u16);
 void		applManufacturerReq(Application_t *appl, struct sk_buff *skb);
@@ -339,7 +421,7 @@ void		ApplicationDelAppPlci(Application_t *, AppPlci_t *);
 void		listenConstr(Application_t *);
 void		listenDestr(Application_t *);
 __u16		listenSendMessage(Application_t *, struct sk_buff *);
-int		listenHandle(Application_t *, __u16);
+void		listenApplMap(Controller_t *, __u16, u_long *);
 
 // ---------------------------------------------------------------------------
 // PLCI prototypes
@@ -387,6 +469,7 @@ void	ncciDestr(Ncci_t *);
 void	ncciApplRelease(Ncci_t *);
 void	ncciDelAppPlci(Ncci_t *);
 void	ncciSendMessage(Ncci_t *, struct sk_buff *);
+int	ncciQueueMessage(Ncci_t *, struct sk_buff *);
 int	ncci_l3l4(Ncci_t *, mISDN_head_t *, struct sk_buff *);
 void	ncciGetCmsg(Ncci_t *, _cmsg *);
 int	ncci_l3l4_direct(Ncci_t *, mISDN_head_t *, struct sk_buff *);
@@ -398,6 +481,8 @@ void	ncciReleaseLink(Ncci_t *);
 
 SSProcess_t	*SSProcessConstr(Application_t *, __u16, __u32);
 void		SSProcessDestr(SSProcess_t *);
+void		__SSProcessDestr(SSProcess_t *);
+void		SSProcessTimeout(unsigned long);
 int		Supplementary_l3l4(Controller_t *, __u32, struct sk_buff *);
 void		SupplementaryFacilityReq(Application_t *, _cmsg *);
 void		SendSSNotificationEvent(AppPlci_t *, u16);
@@ -2,12 +2,30 @@
  *
  */
 
+#include <linux/module.h>
 #include "m_capi.h"
 #include "helper.h"
 #include "debug.h"
 #include "dss1.h"
 #include "mISDNManufacturer.h"
 
+/*
+ * Flow control of NCCIs with NCCI_STATE_FCTRL: with ncci_credit_ms set,
+ * data for up to ncci_credit_ms of link time is passed below the NCCI,
+ * else only one block at a time.
+ */
+static u_int	ncci_credit_ms = 0;
+
+#define NCCI_BYTES_PER_MS	8	/* 64 kbit/s */
+
+#ifdef MODULE
+#ifdef OLD_MODULE_PARAM
+MODULE_PARM(ncci_credit_ms, "1i");
+#else
+module_param(ncci_credit_ms, uint, S_IRUGO | S_IWUSR);
+#endif
+#endif
+
 static int	ncciL4L3(Ncci_t *, u_int, int, int, void *, struct sk_buff *);
 
 static char	logbuf[8000];
@@ -184,6 +202,38 @@ Send2Application(Ncci_t *ncci, _cmsg *cmsg)
 	SendCmsg2Application(ncci->appl, cmsg);
 }
 
+/* DATA_B3_CONF is build directly, without a _cmsg */
+static void
+ncciSendDataConf(Ncci_t *ncci, __u16 msgid, __u16 handle, __u16 info)
+{
+	struct sk_buff	*skb;
+	__u8		*m;
+
+	/* a released application does not get confirmations */
+	if (test_bit(APPL_STATE_RELEASE, &ncci->appl->state))
+		return;
+	if (!(skb = alloc_skb(CAPI_B3_DATA_CONF_SIZE, GFP_ATOMIC))) {
+		printk(KERN_WARNING "%s: no mem for %d bytes\n", __FUNCTION__,
+			CAPI_B3_DATA_CONF_SIZE);
+		int_error();
+		return;
+	}
+	m = skb_put(skb, CAPI_B3_DATA_CONF_SIZE);
+	CAPIMSG_SETLEN(m, CAPI_B3_DATA_CONF_SIZE);
+	CAPIMSG_SETAPPID(m, ncci->appl->ApplId);
+	CAPIMSG_SETCOMMAND(m, CAPI_DATA_B3);
+	CAPIMSG_SETSUBCOMMAND(m, CAPI_CONF);
+	CAPIMSG_SETMSGID(m, msgid);
+	capimsg_setu32(m, 8, ncci->addr);
+	capimsg_setu16(m, 12, handle);
+	capimsg_setu16(m, 14, info);
+#ifdef OLDCAPI_DRIVER_INTERFACE
+	ncci->contr->ctrl->handle_capimsg(ncci->contr->ctrl, ncci->appl->ApplId, skb);
+#else
+	capi_ctr_handle_message(ncci->contr->ctrl, ncci->appl->ApplId, skb);
+#endif
+}
+
 static inline void
 ncciCmsgHeader(Ncci_t *ncci, _cmsg *cmsg, __u8 cmd, __u8 subcmd)
 {
@@ -444,6 +494,8 @@ ncci_connect_b3_active_ind(struct FsmInst *fi, int event, void *arg)
 		ncci->xmit_skb_handles[i].PktId = 0;
 		ncci->recv_skb_handles[i] = 0;
 	}
+	ncci->xmit_busy = 0;
+	ncci->recv_busy = 0;
 	Send2Application(ncci, arg);
 }
 
@@ -843,6 +895,8 @@ ncciConstr(AppPlci_t *aplci)
 	} else
 		ncci->ncci_m.fsm = &ncciD_fsm;
 	skb_queue_head_init(&ncci->squeue);
+	if (test_bit(NCCI_STATE_FCTRL, &ncci->state))
+		ncci->credit = ncci_credit_ms * NCCI_BYTES_PER_MS;
 	if (ncci->window > CAPI_MAXDATAWINDOW) {
 		ncci->window = CAPI_MAXDATAWINDOW;
 	}
@@ -871,6 +925,14 @@ ncciDestr(Ncci_t *ncci)
 		if (ncci->xmit_skb_handles[i].PktId)
 			ncci->xmit_skb_handles[i].PktId = 0;
 	}
+	ncci->xmit_busy = 0;
+	capidebug(CAPI_DBG_NCCI, "NCCI %x xmit %lu max %lu queuefull %lu recv %lu max %lu dropped %lu copied %lu",
+		ncci->addr, ncci->stat.xmit, ncci->stat.xmit_max, ncci->stat.sendqueuefull,
+		ncci->stat.recv, ncci->stat.recv_max, ncci->stat.recv_dropped,
+		ncci->stat.recv_copied);
+	capidebug(CAPI_DBG_NCCI, "NCCI %x credit %d qtime %lu/%lu jiffies underrun %lu",
+		ncci->addr, ncci->credit, ncci->stat.qtime_sum, ncci->stat.qtime_max,
+		ncci->stat.underrun);
 	AppPlciDelNCCI(ncci);
 	ncci_free(ncci);
 }
@@ -898,37 +960,147 @@ ncciReleaseLink(Ncci_t *ncci)
 	mISDN_FsmEvent(&ncci->ncci_m, EV_NC_LINKDOWN, NULL);
 }
 
-void
-ncciDataInd(Ncci_t *ncci, int pr, struct sk_buff *skb)
+/* reserve a free xmit handle, returns the slot or -1 if the window is full */
+static int
+ncci_xmit_get(Ncci_t *ncci)
 {
-	struct sk_buff *nskb;
-	int i;
+	int	i;
+
+	do {
+		i = find_first_zero_bit(&ncci->xmit_busy, CAPI_MAXDATAWINDOW);
+		if (i >= CAPI_MAXDATAWINDOW)
+			return(-1);
+	} while (test_and_set_bit(i, &ncci->xmit_busy));
+	return(i);
+}
+
+static void
+ncci_xmit_put(Ncci_t *ncci, int i)
+{
+	ncci->xmit_skb_handles[i].PktId = 0;
+	clear_bit(i, &ncci->xmit_busy);
+}
 
-	for (i = 0; i < ncci->window; i++) {
-		if (ncci->recv_skb_handles[i] == 0)
+/*
+ * byte credit mode: returns 1 if the block can be sent now, else it is
+ * queued; the squeue lock protects inflight too
+ */
+static int
+ncci_credit_get(Ncci_t *ncci, struct sk_buff *skb)
+{
+	u_long	flags;
+	int	ret = 0;
+
+	spin_lock_irqsave(&ncci->squeue.lock, flags);
+	/* the line ran dry before the application sent the next block */
+	if (!ncci->inflight && ncci->stat.xmit > 1)
+		ncci->stat.underrun++;
+	/* one block is always allowed, so large blocks are not stuck */
+	if (!skb_queue_len(&ncci->squeue) && (!ncci->inflight ||
+		(ncci->inflight + skb->len <= ncci->credit))) {
+		ncci->inflight += skb->len;
+		ret = 1;
+	} else
+		__skb_queue_tail(&ncci->squeue, skb);
+	spin_unlock_irqrestore(&ncci->squeue.lock, flags);
+	return(ret);
+}
+
+/* len bytes are gone, send the queued blocks which fit now */
+static void
+ncci_credit_put(Ncci_t *ncci, int len)
+{
+	struct sk_buff	*skb;
+	u_long		flags;
+	int		i;
+
+	spin_lock_irqsave(&ncci->squeue.lock, flags);
+	ncci->inflight -= len;
+	if (ncci->inflight < 0)
+		ncci->inflight = 0;
+	while ((skb = skb_peek(&ncci->squeue))) {
+		if (ncci->inflight && (ncci->inflight + skb->len > ncci->credit))
 			break;
+		__skb_unlink(skb, &ncci->squeue);
+		ncci->inflight += skb->len;
+		spin_unlock_irqrestore(&ncci->squeue.lock, flags);
+		if (ncciL4L3(ncci, DL_DATA | REQUEST, mISDN_HEAD_DINFO(skb),
+			0, NULL, skb)) {
+			int_error();
+			/* give the slot back, like ncciDataReq() does */
+			i = NCCI_PKTID_SLOT(mISDN_HEAD_DINFO(skb));
+			if (ncci->xmit_skb_handles[i].PktId != mISDN_HEAD_DINFO(skb))
+				int_error();
+			else {
+				ncciSendDataConf(ncci, ncci->xmit_skb_handles[i].MsgId,
+					ncci->xmit_skb_handles[i].DataHandle, CAPI_MSGBUSY);
+				ncci_xmit_put(ncci, i);
+			}
+			len = skb->len;
+			dev_kfree_skb(skb);
+			spin_lock_irqsave(&ncci->squeue.lock, flags);
+			ncci->inflight -= len;
+			continue;
+		}
+		spin_lock_irqsave(&ncci->squeue.lock, flags);
 	}
+	spin_unlock_irqrestore(&ncci->squeue.lock, flags);
+}
 
-	if (i == ncci->window) {
+/* unique for this NCCI, not MISDN_ID_DUMMY or 0, the low bits are the slot */
+static __u32
+ncci_pktid(Ncci_t *ncci, int i)
+{
+	ncci->xmit_seq++;
+	return((ncci->contr->entity << 16) | NCCI_PKTID_LOCAL |
+		((ncci->xmit_seq * CAPI_MAXDATAWINDOW) & 0x7fff) | i);
+}
+
+void
+ncciDataInd(Ncci_t *ncci, int pr, struct sk_buff *skb)
+{
+	struct sk_buff *nskb;
+	int i, used;
+
+	i = find_first_zero_bit(&ncci->recv_busy, ncci->window);
+	if (i >= ncci->window) {
 		// FIXME: trigger flow control if supported by L2 protocol
 		printk(KERN_DEBUG "%s: frame %d dropped\n", __FUNCTION__, skb->len);
+		ncci->stat.recv_dropped++;
 		dev_kfree_skb(skb);
 		return;
 	}
 
-	if (skb_headroom(skb) < CAPI_B3_DATA_IND_HEADER_SIZE) {
-		capidebug(CAPI_DBG_NCCI_L3, "%s: only %d bytes headroom, need %d",
-			__FUNCTION__, skb_headroom(skb), CAPI_B3_DATA_IND_HEADER_SIZE);
-		nskb = skb_realloc_headroom(skb, CAPI_B3_DATA_IND_HEADER_SIZE);
-		dev_kfree_skb(skb);
+	/*
+	 * normally the B-channel allocated the skb with up_headerlen headroom
+	 * (set in AppPlciLinkUp()), so the header is pushed in place and the
+	 * application gets the received buffer; the data is copied only if
+	 * the headroom is too small or the data is shared with a clone
+	 */
+	nskb = skb;
+	if (skb_headroom(skb) < CAPI_B3_DATA_IND_HEADER_SIZE || skb_cloned(skb)) {
+		capidebug(CAPI_DBG_NCCI_L3, "%s: %d bytes headroom, need %d%s",
+			__FUNCTION__, skb_headroom(skb), CAPI_B3_DATA_IND_HEADER_SIZE,
+			skb_cloned(skb) ? " cloned" : "");
+		ncci->stat.recv_copied++;
+		if (skb_shared(skb)) {
+			nskb = skb_realloc_headroom(skb, CAPI_B3_DATA_IND_HEADER_SIZE);
+			dev_kfree_skb(skb);
+		} else if (skb_cow(skb, CAPI_B3_DATA_IND_HEADER_SIZE)) {
+			dev_kfree_skb(skb);
+			nskb = NULL;
+		}
 		if (!nskb) {
 			int_error();
 			return;
 		}
-      	} else { 
-		nskb = skb;
 	}
 	ncci->recv_skb_handles[i] = nskb;
+	set_bit(i, &ncci->recv_busy);
+	ncci->stat.recv++;
+	used = hweight_long(ncci->recv_busy);
+	if (used > ncci->stat.recv_max)
+		ncci->stat.recv_max = used;
 
 	skb_push(nskb, CAPI_B3_DATA_IND_HEADER_SIZE);
 	CAPIMSG_SETLEN(nskb->data, CAPI_B3_DATA_IND_HEADER_SIZE);
@@ -958,9 +1130,8 @@ ncciDataInd(Ncci_t *ncci, int pr, struct sk_buff *skb)
 __u16
 ncciDataReq(Ncci_t *ncci, struct sk_buff *skb)
 {
-	int	i, err;
+	int	i, err, used;
 	__u16	len, capierr = 0;
-	_cmsg	*cmsg;
 
 	len = CAPIMSG_LEN(skb->data);
 	if (len != 22 && len != 30) {
@@ -968,23 +1139,28 @@ ncciDataReq(Ncci_t *ncci, struct sk_buff *skb)
 		int_error();
 		goto fail;
 	}
-	for (i = 0; i < CAPI_MAXDATAWINDOW; i++) {
-		/* try reserving a slot atomically (use an invalid Id) */
-		if (cmpxchg(&ncci->xmit_skb_handles[i].PktId, 0, MISDN_ID_DUMMY) == 0)
-			break;
-	}
-	if (i == CAPI_MAXDATAWINDOW) {
+	if ((i = ncci_xmit_get(ncci)) < 0) {
+		ncci->stat.sendqueuefull++;
 		return(CAPI_SENDQUEUEFULL);
 	}
-	mISDN_HEAD_DINFO(skb) = ControllerNextId(ncci->contr);
+	ncci->stat.xmit++;
+	used = hweight_long(ncci->xmit_busy);
+	if (used > ncci->stat.xmit_max)
+		ncci->stat.xmit_max = used;
+	mISDN_HEAD_DINFO(skb) = ncci_pktid(ncci, i);
 	ncci->xmit_skb_handles[i].PktId = mISDN_HEAD_DINFO(skb);
 	ncci->xmit_skb_handles[i].DataHandle = CAPIMSG_REQ_DATAHANDLE(skb->data);
 	ncci->xmit_skb_handles[i].MsgId = CAPIMSG_MSGID(skb->data);
 
 	/* the data begins behind the header, we don't use Data32/Data64 here */
 	skb_pull(skb, len);
+	ncci->xmit_skb_handles[i].Len = skb->len;
+	ncci->xmit_skb_handles[i].Stamp = jiffies;
 
-	if (test_bit(NCCI_STATE_FCTRL, &ncci->state)) {
+	if (ncci->credit) {
+		if (!ncci_credit_get(ncci, skb))
+			return(CAPI_NOERROR);
+	} else if (test_bit(NCCI_STATE_FCTRL, &ncci->state)) {
 		if (test_and_set_bit(NCCI_STATE_BUSY, &ncci->state)) {
 			skb_queue_tail(&ncci->squeue, skb);
 			return(CAPI_NOERROR);
@@ -1000,37 +1176,24 @@ ncciDataReq(Ncci_t *ncci, struct sk_buff *skb)
 		return(CAPI_NOERROR);
 
 	int_error();
+	if (ncci->credit)
+		ncci_credit_put(ncci, skb->len);
 	skb_push(skb, len);
 	capierr = CAPI_MSGBUSY;
 	if (i == -1) {
-		for (i = 0; i < CAPI_MAXDATAWINDOW; i++) {
-			if (ncci->xmit_skb_handles[i].PktId == mISDN_HEAD_DINFO(skb))
-				break;
-		}
-		if (i == CAPI_MAXDATAWINDOW)
+		i = NCCI_PKTID_SLOT(mISDN_HEAD_DINFO(skb));
+		if (ncci->xmit_skb_handles[i].PktId != mISDN_HEAD_DINFO(skb))
 			int_error();
 		else
-			ncci->xmit_skb_handles[i].PktId = 0;
+			ncci_xmit_put(ncci, i);
 	} else {
-		ncci->xmit_skb_handles[i].PktId = 0;
+		ncci_xmit_put(ncci, i);
 		return(capierr);
 	}
 fail:
-	cmsg = cmsg_alloc();
-	if (!cmsg) {
-		int_error();
-		if (capierr != CAPI_MSGBUSY)
-			return(CAPI_MSGOSRESOURCEERR);
-		/* we can not do error handling on a skb from the queue here */	
-		dev_kfree_skb(skb);
-		return(CAPI_NOERROR);
-	}
-	capi_cmsg_header(cmsg, ncci->AppPlci->appl->ApplId, CAPI_DATA_B3, CAPI_CONF, 
-		CAPIMSG_MSGID(skb->data), ncci->addr);
 	/* illegal len (too short) ??? */
-	cmsg->DataHandle = CAPIMSG_REQ_DATAHANDLE(skb->data);
-	cmsg->Info = capierr;
-	Send2Application(ncci, cmsg);
+	ncciSendDataConf(ncci, CAPIMSG_MSGID(skb->data),
+		CAPIMSG_REQ_DATAHANDLE(skb->data), capierr);
 	dev_kfree_skb(skb);
 	return(CAPI_NOERROR);
 }
@@ -1038,14 +1201,11 @@ fail:
 int
 ncciDataConf(Ncci_t *ncci, int pr, struct sk_buff *skb)
 {
-	int	i;
-	_cmsg	*cmsg;
+	int	i, len;
+	u_long	qtime;
 
-	for (i = 0; i < CAPI_MAXDATAWINDOW; i++) {
-		if (ncci->xmit_skb_handles[i].PktId == mISDN_HEAD_DINFO(skb))
-			break;
-	}
-	if (i == CAPI_MAXDATAWINDOW) {
+	i = NCCI_PKTID_SLOT(mISDN_HEAD_DINFO(skb));
+	if (ncci->xmit_skb_handles[i].PktId != mISDN_HEAD_DINFO(skb)) {
 		int_error();
 		printk(KERN_DEBUG "%s: dinfo(%x)\n", __FUNCTION__, mISDN_HEAD_DINFO(skb));
 		for (i = 0; i < CAPI_MAXDATAWINDOW; i++)
@@ -1055,20 +1215,18 @@ ncciDataConf(Ncci_t *ncci, int pr, struct sk_buff *skb)
 	capidebug(CAPI_DBG_NCCI_L3, "%s: entry %d/%d handle (%x)",
 		__FUNCTION__, i, CAPI_MAXDATAWINDOW, ncci->xmit_skb_handles[i].DataHandle);
 
-	cmsg = cmsg_alloc();
-	if (!cmsg) {
-		int_error();
-		ncci->xmit_skb_handles[i].PktId = 0;
-		return(-ENOMEM);
-	}
 	dev_kfree_skb(skb);
-	capi_cmsg_header(cmsg, ncci->AppPlci->appl->ApplId, CAPI_DATA_B3, CAPI_CONF, 
-			 ncci->xmit_skb_handles[i].MsgId, ncci->addr);
-	cmsg->DataHandle = ncci->xmit_skb_handles[i].DataHandle;
-	cmsg->Info = 0;
-	ncci->xmit_skb_handles[i].PktId = 0;
-	Send2Application(ncci, cmsg);
-	if (test_bit(NCCI_STATE_FCTRL, &ncci->state)) {
+	qtime = jiffies - ncci->xmit_skb_handles[i].Stamp;
+	ncci->stat.qtime_sum += qtime;
+	if (qtime > ncci->stat.qtime_max)
+		ncci->stat.qtime_max = qtime;
+	len = ncci->xmit_skb_handles[i].Len;
+	ncciSendDataConf(ncci, ncci->xmit_skb_handles[i].MsgId,
+		ncci->xmit_skb_handles[i].DataHandle, 0);
+	ncci_xmit_put(ncci, i);
+	if (ncci->credit) {
+		ncci_credit_put(ncci, len);
+	} else if (test_bit(NCCI_STATE_FCTRL, &ncci->state)) {
 		if (skb_queue_len(&ncci->squeue)) {
 			skb = skb_dequeue(&ncci->squeue);
 			if (ncciL4L3(ncci, DL_DATA | REQUEST, mISDN_HEAD_DINFO(skb),
@@ -1091,15 +1249,18 @@ ncciDataResp(Ncci_t *ncci, struct sk_buff *skb)
 	int i;
 
 	i = CAPIMSG_RESP_DATAHANDLE(skb->data);
-	if (i < 0 || i > ncci->window) {
+	if (i < 0 || i >= ncci->window) {
 		int_error();
 		return;
 	}
-	if (!ncci->recv_skb_handles[i]) {
+	if (!test_bit(i, &ncci->recv_busy)) {
 		int_error();
 		return;
 	}
+	/* the slot may be taken again by ncciDataInd() after the clear_bit */
 	ncci->recv_skb_handles[i] = 0;
+	smp_mb();
+	clear_bit(i, &ncci->recv_busy);
 
 	dev_kfree_skb(skb);
 }
@@ -1256,6 +1417,32 @@ ncciSendMessage(Ncci_t *ncci, struct sk_buff *skb)
 	return;
 }
 
+/*
+ * pass a application request to the stack thread of the B-channel, so
+ * it is handled in order with the DATA_B3 messages of this NCCI and not
+ * on the controller thread
+ */
+int
+ncciQueueMessage(Ncci_t *ncci, struct sk_buff *skb)
+{
+	int	err;
+
+	if (!ncci->link) {
+		int_error();
+		return(-ENODEV);
+	}
+	if (ncci->link->inst.id == 0) {
+		/* stack is already cleared, handle it here */
+		ncciSendMessage(ncci, skb);
+		return(0);
+	}
+	mISDN_HEAD_P(skb)->prim = CAPI_MESSAGE_REQUEST;
+	err = mISDN_queue_message(&ncci->link->inst, 0, skb);
+	if (err)
+		int_errtxt("mISDN_queue_message return(%d)", err);
+	return(err);
+}
+
 int
 ncci_l3l4_direct(Ncci_t *ncci, mISDN_head_t *hh, struct sk_buff *skb)
 {
@@ -1395,12 +1582,14 @@ init_ncci(void)
 	ncci_fsm.event_count = EV_NCCI_COUNT;
 	ncci_fsm.strEvent = str_ev_ncci;
 	ncci_fsm.strState = str_st_ncci;
+	ncci_fsm.name = "ncci";
 	mISDN_FsmNew(&ncci_fsm, fn_ncci_list, FN_NCCI_COUNT);
 
 	ncciD_fsm.state_count = ST_NCCI_COUNT;
 	ncciD_fsm.event_count = EV_NCCI_COUNT;
 	ncciD_fsm.strEvent = str_ev_ncci;
 	ncciD_fsm.strState = str_st_ncci;
+	ncciD_fsm.name = "nccid";
 	mISDN_FsmNew(&ncciD_fsm, fn_ncciD_list, FN_NCCID_COUNT);
 }
 
@@ -16,10 +16,12 @@
 #include "isac.h"
 #include "layer1.h"
 #include "debug.h"
+#include "irq_bh.h"
 
 #include <linux/ppp_defs.h>
 
 #include "netjet.h"
+#include "sw_hdlc.h"
 
 //#define DPRINT(...)
 //#define DTRACE(...)
@@ -33,6 +35,7 @@ static int debug;
 static int netjet_cnt;
 static u_int protocol[MAX_CARDS];
 static int layermask[MAX_CARDS];
+static int irq_bh;	/* use the common bottom half */
 
 #ifdef MODULE
 MODULE_AUTHOR("Daniel Potts");
@@ -42,11 +45,13 @@ MODULE_LICENSE("GPL");
 
 #ifdef OLD_MODULE_PARAM
 MODULE_PARM(debug, "1i");
+MODULE_PARM(irq_bh, "1i");
 #define MODULE_PARM_T	"1-4i"
 MODULE_PARM(protocol, MODULE_PARM_T);
 MODULE_PARM(layermask, MODULE_PARM_T);
 #else
 module_param(debug, uint, S_IRUGO | S_IWUSR);
+module_param(irq_bh, uint, S_IRUGO);
 #ifdef OLD_MODULE_PARAM_ARRAY
 static int num_protocol=0,num_layermask=0;
 module_param_array(protocol, uint, num_protocol, S_IRUGO | S_IWUSR);
@@ -121,13 +126,10 @@ struct tiger_hw {
 	u_char *sp;
 	int sendcnt;
 	u_int s_tot;
-	u_int r_bitcnt;
 	u_int r_tot;
 	u_int r_err;
-	u_int r_fcs;
-	u_char r_state;
-	u_char r_one;
-	u_char r_val;
+	hdlc_dec_t dec;
+	u_char raw[NETJET_DMA_RXSIZE/2];	/* channel octets for the decoder */
 	u_char s_state;
 
 	u_char	*tx_buf;
@@ -156,6 +158,9 @@ typedef struct {
 	unsigned char last_is0;
 
 	unsigned char irqmask0;
+	mISDN_irq_bh_t		bh;
+	u_char			isac_pend;	/* ISAC masked, ISTA not read yet */
+	u_char			dma_pend;	/* free pages seen by the hardirq */
 } netjet_t;
 
 
@@ -247,6 +252,15 @@ fill_mem(channel_t *bch, u_int *pos, u_int cnt, int chan, u_char fill)
 	}
 }
 
+/* neither HDLC nor transparent is the 56k HDLC mode, see netjet_fill_dma() */
+static inline int
+tiger_hdlc_bits(channel_t *bch)
+{
+	if (test_bit(FLG_HDLC, &bch->Flags) ||
+		test_bit(FLG_TRANSPARENT, &bch->Flags))
+		return(HDLC_BITS_64K);
+	return(HDLC_BITS_56K);
+}
 
 int
 mode_tiger(channel_t *bch, int bc, int protocol)
@@ -316,10 +330,8 @@ mode_tiger(channel_t *bch, int bc, int protocol)
 			test_and_set_bit(FLG_HDLC, &bch->Flags);
 		fill_mem(bch, tiger->send.dmabuf,
 			 NETJET_DMA_TXSIZE, bc, 0xff);
-		tiger->r_state = HDLC_ZERO_SEARCH;
+		mISDN_hdlc_dec_init(&tiger->dec, tiger_hdlc_bits(bch));
 		tiger->r_tot = 0;
-		tiger->r_bitcnt = 0;
-		tiger->r_one = 0;
 		tiger->r_err = 0;
 		tiger->s_tot = 0;
 		if (! card->dmactrl) {
@@ -658,35 +670,6 @@ void printframe(mISDNinstance_t *cs, u_char *buf, int count, char *s)
 }
 
 
-// macro for 64k
-#define MAKE_RAW_BYTE for (j=0; j<8; j++) { \
-			bitcnt++;\
-			s_val >>= 1;\
-			if (val & 1) {\
-				s_one++;\
-				s_val |= 0x80;\
-			} else {\
-				s_one = 0;\
-				s_val &= 0x7f;\
-			}\
-			if (bitcnt==8) {\
-				tiger->tx_buf[s_cnt++] = s_val;\
-				bitcnt = 0;\
-			}\
-			if (s_one == 5) {\
-				s_val >>= 1;\
-				s_val &= 0x7f;\
-				bitcnt++;\
-				s_one = 0;\
-			}\
-			if (bitcnt==8) {\
-				tiger->tx_buf[s_cnt++] = s_val;\
-				bitcnt = 0;\
-			}\
-			val >>= 1;\
-		}
-
-
 static int 
 make_raw_data_transparent(channel_t *bch, struct sk_buff *skb) 
 {
@@ -712,18 +695,21 @@ make_raw_data_transparent(channel_t *bch, struct sk_buff *skb)
 }
 
 
+/*
+ * The output is the same as of the old bit loops: opening flag, stuffed
+ * data and FCS, closing flag. If the closing flag ends within a octet,
+ * this octet is filled with 1 bits and one more 0xff octet follows
+ * (NJ<->NJ throughput fix). In 56k mode a octet holds 7 bits and the
+ * MSB is 1, so the filled octet has 7 - nacc fill bits plus the MSB.
+ * If the closing flag ends at a octet boundary no fill octet is sent,
+ * in both modes.
+ */
 static int 
-make_raw_data(channel_t *bch, struct sk_buff *skb) 
+make_raw_data(channel_t *bch, struct sk_buff *skb, int bits) 
 {
-	// this make_raw is for 64k
-	u_int i,s_cnt=0;
-	u_char j;
-	u_char val;
-	u_char s_one = 0;
-	u_char s_val = 0;
-	u_char bitcnt = 0;
-	u_int fcs;
-
+	// HDLC for 64k (8 bits) and 56k (7 bits)
+	u_int s_cnt;
+	hdlc_enc_t enc;
 	struct tiger_hw *tiger;
 
 	tiger = bch->hw;
@@ -733,156 +719,14 @@ make_raw_data(channel_t *bch, struct sk_buff *skb)
 		return(1);
 	}
 
-	tiger->tx_buf[s_cnt++] = HDLC_FLAG_VALUE;
-	fcs = PPP_INITFCS;
-	for (i=0; i<skb->len; i++) {
-		val = skb->data[i];
-		fcs = PPP_FCS (fcs, val);
-		MAKE_RAW_BYTE;
-	}
-	fcs ^= 0xffff;
-	val = fcs & 0xff;
-	MAKE_RAW_BYTE;
-	val = (fcs>>8) & 0xff;
-	MAKE_RAW_BYTE;
-	val = HDLC_FLAG_VALUE;
-	for (j=0; j<8; j++) { 
-		bitcnt++;
-		s_val >>= 1;
-		if (val & 1)
-			s_val |= 0x80;
-		else
-			s_val &= 0x7f;
-		if (bitcnt==8) {
-			tiger->tx_buf[s_cnt++] = s_val;
-			bitcnt = 0;
-		}
-		val >>= 1;
-	}
+	mISDN_hdlc_enc_init(&enc, bits);
+	s_cnt = mISDN_hdlc_encode(&enc, tiger->tx_buf, skb->data, skb->len);
 	if (bch->debug & L1_DEB_HSCX)
-		mISDN_debugprint(&bch->inst,"tiger make_raw: in %ld out %d.%d",
-				 skb->len, s_cnt, bitcnt);
-	if (bitcnt) {
-		while (8>bitcnt++) {
-			s_val >>= 1;
-			s_val |= 0x80;
-		}
-		tiger->tx_buf[s_cnt++] = s_val;
-		tiger->tx_buf[s_cnt++] = 0xff;	// NJ<->NJ thoughput bug fix
-	}
-	tiger->sendcnt = s_cnt;
-	tiger->sp = tiger->tx_buf;
-	return(0);
-}
-
-
-// macro for 56k
-#define MAKE_RAW_BYTE_56K for (j=0; j<8; j++) { \
-			bitcnt++;\
-			s_val >>= 1;\
-			if (val & 1) {\
-				s_one++;\
-				s_val |= 0x80;\
-			} else {\
-				s_one = 0;\
-				s_val &= 0x7f;\
-			}\
-			if (bitcnt==7) {\
-				s_val >>= 1;\
-				s_val |= 0x80;\
-				tiger->tx_buf[s_cnt++] = s_val;\
-				bitcnt = 0;\
-			}\
-			if (s_one == 5) {\
-				s_val >>= 1;\
-				s_val &= 0x7f;\
-				bitcnt++;\
-				s_one = 0;\
-			}\
-			if (bitcnt==7) {\
-				s_val >>= 1;\
-				s_val |= 0x80;\
-				tiger->tx_buf[s_cnt++] = s_val;\
-				bitcnt = 0;\
-			}\
-			val >>= 1;\
-		}
-
-
-static int 
-make_raw_data_56k(channel_t *bch, struct sk_buff *skb)
-{
-	// this make_raw is for 56k
-	u_int i,s_cnt=0;
-	u_char j;
-	u_char val;
-	u_char s_one = 0;
-	u_char s_val = 0;
-	u_char bitcnt = 0;
-	u_int fcs;
-
-	struct tiger_hw *tiger;
-
-	tiger = bch->hw;
-
-	if (!skb) {
-		mISDN_debugprint(&bch->inst, "tiger make_raw_56k: NULL skb");
-		return(1);
-	}
-
-	val = HDLC_FLAG_VALUE;
-	for (j=0; j<8; j++) { 
-		bitcnt++;
-		s_val >>= 1;
-		if (val & 1)
-			s_val |= 0x80;
-		else
-			s_val &= 0x7f;
-		if (bitcnt==7) {
-			s_val >>= 1;
-			s_val |= 0x80;
-			tiger->tx_buf[s_cnt++] = s_val;
-			bitcnt = 0;
-		}
-		val >>= 1;
-	};
-	fcs = PPP_INITFCS;
-	for (i=0; i<skb->len; i++) {
-		val = skb->data[i];
-		fcs = PPP_FCS (fcs, val);
-		MAKE_RAW_BYTE_56K;
-	}
-	fcs ^= 0xffff;
-	val = fcs & 0xff;
-	MAKE_RAW_BYTE_56K;
-	val = (fcs>>8) & 0xff;
-	MAKE_RAW_BYTE_56K;
-	val = HDLC_FLAG_VALUE;
-	for (j=0; j<8; j++) { 
-		bitcnt++;
-		s_val >>= 1;
-		if (val & 1)
-			s_val |= 0x80;
-		else
-			s_val &= 0x7f;
-		if (bitcnt==7) {
-			s_val >>= 1;
-			s_val |= 0x80;
-			tiger->tx_buf[s_cnt++] = s_val;
-			bitcnt = 0;
-		}
-		val >>= 1;
-	}
-	if (bch->debug & L1_DEB_HSCX)
-		mISDN_debugprint(&bch->inst,
-				 "tiger make_raw_56k: in %ld out %d.%d",
-				 skb->len, s_cnt, bitcnt);
-	if (bitcnt) {
-		while (8>bitcnt++) {
-			s_val >>= 1;
-			s_val |= 0x80;
-		}
-		tiger->tx_buf[s_cnt++] = s_val;
+		mISDN_debugprint(&bch->inst,"tiger make_raw%s: in %ld out %d.%d",
+				 (bits == HDLC_BITS_56K) ? "_56k" : "",
+				 skb->len, s_cnt, enc.nacc);
+	if (enc.nacc) {
+		s_cnt += mISDN_hdlc_enc_flush(&enc, tiger->tx_buf + s_cnt);
 		tiger->tx_buf[s_cnt++] = 0xff;	// NJ<->NJ thoughput bug fix
 	}
 	tiger->sendcnt = s_cnt;
@@ -914,13 +758,13 @@ netjet_fill_dma(channel_t *bch)
 				 bch->channel, bch->Flags);
 
 	if (test_bit(FLG_HDLC, &bch->Flags)) {		// it's 64k
-		if (make_raw_data(bch, skb))
+		if (make_raw_data(bch, skb, HDLC_BITS_64K))
 			return;		
 	} else if (test_bit(FLG_TRANSPARENT, &bch->Flags)) {
 		if (make_raw_data_transparent(bch, skb))
 			return;
 	} else { 						// it's 56k
-		if (make_raw_data_56k(bch, skb))
+		if (make_raw_data(bch, skb, HDLC_BITS_56K))
 			return;		
 	}
 	if (bch->debug & L1_DEB_HSCX)
@@ -1155,23 +999,11 @@ read_raw_transparent(channel_t *bch, u_int *buf, int cnt)
 static void 
 read_raw(channel_t *bch, u_int *buf, int cnt)
 {
-	int i;
-	u_char j;
-	u_char val;
 	struct tiger_hw *tiger;
 	u_int  *pend;
-
-	u_char state;
-	u_char r_one;
-	u_char r_val;
-	u_int bitcnt;
-
-	int bits;
-	u_char mask;
-
 	u_int *p = buf;
-
-	u_char *skb_ptr;
+	u_char *raw;
+	int i, done, ret;
 
 	if (!bch->rx_skb) {
 		if (!(bch->rx_skb = alloc_stack_skb(bch->maxlen, bch->up_headerlen))) {
@@ -1180,183 +1012,45 @@ read_raw(channel_t *bch, u_int *buf, int cnt)
 		}
 	}
 
-	skb_ptr = skb_put (bch->rx_skb, 0);
-
 	tiger = bch->hw;
+	raw = tiger->raw;
 	pend = tiger->rec.dmabuf + NETJET_DMA_RXSIZE - 1;
-	state = tiger->r_state;
-	r_one = tiger->r_one;
-	r_val = tiger->r_val;
-	bitcnt = tiger->r_bitcnt;
-
-        if (test_bit(FLG_HDLC, &bch->Flags)) {
-		mask = 0xff;
-		bits = 8;
-	}
-	else { // it's 56K
-		mask = 0x7f;
-		bits = 7;
-	};
+	if (cnt > sizeof(tiger->raw))
+		cnt = sizeof(tiger->raw);
 	for (i=0;i<cnt;i++) {
-		val = bch->channel ? ((*p>>8) & 0xff) : (*p & 0xff);
+		raw[i] = bch->channel ? ((*p>>8) & 0xff) : (*p & 0xff);
 		p++;
 		if (p > pend)
 			p = tiger->rec.dmabuf;
-		if ((val & mask) == mask) {
-			state = HDLC_ZERO_SEARCH;
-			tiger->r_tot++;
-			bitcnt = 0;
-			r_one = 0;
-			continue;
-		}
-		for (j=0;j<bits;j++) {
-			if (state == HDLC_ZERO_SEARCH) {
-				if (val & 1) {
-					r_one++;
-				} else {
-					r_one = 0;
-					state = HDLC_FLAG_SEARCH;
-					if (bch->debug & L1_DEB_HSCX)
-						mISDN_debugprint(&bch->inst,"tiger read_raw: zBit(%d,%d,%d) %x",
-								 tiger->r_tot,i,j,val);
-				}
-			} else if (state == HDLC_FLAG_SEARCH) { 
-				if (val & 1) {
-					r_one++;
-					if (r_one>6) {
-						state = HDLC_ZERO_SEARCH;
-					}
-				} else {
-					if (r_one==6) {
-						bitcnt = 0;
-						r_val = 0;
-						state = HDLC_FLAG_FOUND;
-						if (bch->debug & L1_DEB_HSCX)
-							mISDN_debugprint(&bch->inst,"tiger read_raw: flag(%d,%d,%d) %x",
-									 tiger->r_tot,i,j,val);
-					}
-					r_one=0;
-				}
-			} else if (state ==  HDLC_FLAG_FOUND) {
-				if (val & 1) {
-					r_one++;
-					if (r_one>6) {
-						state=HDLC_ZERO_SEARCH;
-					} else {
-						r_val >>= 1;
-						r_val |= 0x80;
-						bitcnt++;
-					}
-				} else {
-					if (r_one==6) {
-						bitcnt=0;
-						r_val=0;
-						r_one=0;
-						val >>= 1;
-						continue;
-					} else if (r_one!=5) {
-						r_val >>= 1;
-						r_val &= 0x7f;
-						bitcnt++;
-					}
-					r_one=0;	
-				}
-				if ((state != HDLC_ZERO_SEARCH) &&
-					!(bitcnt & 7)) {
-					state=HDLC_FRAME_FOUND;
-					tiger->r_fcs = PPP_INITFCS;
-					skb_ptr[0] = r_val;
-					tiger->r_fcs = PPP_FCS (tiger->r_fcs, r_val);
-					if (bch->debug & L1_DEB_HSCX)
-						mISDN_debugprint(&bch->inst,"tiger read_raw: byte1(%d,%d,%d) rval %x val %x i (N/A)",
-								 tiger->r_tot,i,j,r_val,val
-								 /*,bcs->cs->hw.njet.irqstat0*/);
-				}
-			} else if (state ==  HDLC_FRAME_FOUND) {
-				if (val & 1) {
-					r_one++;
-					if (r_one>6) {
-						state=HDLC_ZERO_SEARCH;
-						bitcnt=0;
-					} else {
-						r_val >>= 1;
-						r_val |= 0x80;
-						bitcnt++;
-					}
-				} else {
-					if (r_one==6) {
-						r_val=0; 
-						r_one=0;
-						bitcnt++;
-						if (bitcnt & 7) {
-							mISDN_debugprint(&bch->inst, "tiger: frame not byte aligned");
-							state=HDLC_FLAG_SEARCH;
-							tiger->r_err++;
-#ifdef ERROR_STATISTIC
-							bcs->err_inv++;
-#endif
-						} else {
-							if (bch->debug & L1_DEB_HSCX)
-								mISDN_debugprint(&bch->inst,"tiger frame end(%d,%d): fcs(%x) i (N/A)",
-										 i,j,tiger->r_fcs/*, bcs->cs->hw.njet.irqstat0*/);
-							if (tiger->r_fcs == PPP_GOODFCS) {
-								skb_put (bch->rx_skb, (bitcnt>>3)-3);
-								got_frame(bch, (bitcnt>>3)-3);
-								if (!bch->rx_skb) {
-									if (!(bch->rx_skb = alloc_stack_skb(bch->maxlen, bch->up_headerlen))) {
-										printk(KERN_WARNING "mISDN: B receive out of memory\n");
-										return;
-									}
-								}
-								skb_ptr = skb_put (bch->rx_skb, 0);
-							} else {
-								if (bch->debug) {
-									mISDN_debugprint(&bch->inst, "tiger FCS error");
-									tiger->r_err++;
-								}
-#ifdef ERROR_STATISTIC
-							bcs->err_crc++;
-#endif
-							}
-							state=HDLC_FLAG_FOUND;
-						}
-						bitcnt=0;
-					} else if (r_one==5) {
-						val >>= 1;
-						r_one=0;
-						continue;
-					} else {
-						r_val >>= 1;
-						r_val &= 0x7f;
-						bitcnt++;
-					}
-					r_one=0;	
+	}
+	tiger->r_tot += cnt;
+
+	i = 0;
+	while (i < cnt) {
+		ret = mISDN_hdlc_decode(&tiger->dec, raw + i, cnt - i, &done,
+			bch->rx_skb->data, skb_tailroom(bch->rx_skb));
+		i += done;
+		if (ret > 0) {
+			skb_put(bch->rx_skb, ret);
+			got_frame(bch, ret);
+			if (!bch->rx_skb) {
+				if (!(bch->rx_skb = alloc_stack_skb(bch->maxlen, bch->up_headerlen))) {
+					printk(KERN_WARNING "mISDN: B receive out of memory\n");
+					return;
 				}
-				if ((state == HDLC_FRAME_FOUND) &&
-					!(bitcnt & 7)) {
-					if ((bitcnt>>3) >= bch->maxlen) {
-						mISDN_debugprint(&bch->inst, "tiger: frame too big");
-						r_val=0; 
-						state=HDLC_FLAG_SEARCH;
-						tiger->r_err++;
+			}
+		} else if (ret < 0) {
+			tiger->r_err++;
+			if (bch->debug)
+				mISDN_debugprint(&bch->inst, "tiger frame error %d", ret);
 #ifdef ERROR_STATISTIC
-						bcs->err_inv++;
+			if (ret == HDLC_DEC_ERR_CRC)
+				bcs->err_crc++;
+			else
+				bcs->err_inv++;
 #endif
-					} else {
-						skb_ptr[(bitcnt>>3)-1] = r_val;
-						tiger->r_fcs = 
-							PPP_FCS (tiger->r_fcs, r_val);
-					}
-				}
-			}
-			val >>= 1;
 		}
-		tiger->r_tot++;
 	}
-	tiger->r_state = state;
-	tiger->r_one = r_one;
-	tiger->r_val = r_val;
-	tiger->r_bitcnt = bitcnt;
 }
 
 /* read_tiger()
@@ -1464,40 +1158,25 @@ write_tiger_bch(channel_t *bch, u_int *buf, int cnt) {
 	}
 }
 
-static irqreturn_t
-nj_interrupt(int intno, void *dev_id, struct pt_regs *regs)
+static void
+nj_isac_int(netjet_t *card)
 {
-	netjet_t *card = dev_id;
-	u_int8_t val, s1val, s0val;
-
-	spin_lock(&card->lock);
+	u_int8_t val;
 
-	s0val = inb (card->base | NETJET_IRQSTAT0);
-	s1val = inb (card->base | NETJET_IRQSTAT1);
-	if ( ((s1val & NETJET_ISACIRQ) != 0) && (s0val == 0)) {
-		/* no interrupts for us */
-		/* shared IRQ */
-		spin_unlock(&card->lock);
-		return IRQ_NONE;
-	}
-
-	card->irqcnt++;
-
-	if (!(s1val & NETJET_ISACIRQ)) {
-		val = nj_readISAC(card, ISAC_ISTA);
-		if (val) {
-			mISDN_isac_interrupt(&card->dch, val);
-			nj_writeISAC(card, ISAC_MASK, 0xFF);
-			nj_writeISAC(card, ISAC_MASK, 0x0);
-		}
+	val = nj_readISAC(card, ISAC_ISTA);
+	if (val) {
+		mISDN_isac_interrupt(&card->dch, val);
+		nj_writeISAC(card, ISAC_MASK, 0xFF);
 	}
+	nj_writeISAC(card, ISAC_MASK, 0x0);
+}
 
-	if (s0val) {
-		/* write to clear */
-		outb (s0val, card->base | NETJET_IRQSTAT0);
-	}
+/* the free DMA pages as NETJET_IRQM0 bits, from the DMA positions */
+static u_int8_t
+nj_dma_page(netjet_t *card)
+{
+	u_int8_t s0val;
 
-	/* set bits in sval to indicate which page is free */
 	if (inl(card->base | NETJET_DMA_WRITE_ADR) <
 	    inl(card->base | NETJET_DMA_WRITE_IRQ)) {
 		/* the 2nd write page is free */
@@ -1514,6 +1193,13 @@ nj_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 		/* the 1st read page is free */
 		s0val |= 0x01;	
 	}
+	return(s0val);
+}
+
+static void
+nj_dma_int(netjet_t *card)
+{
+	u_int8_t s0val = nj_dma_page(card);
 
 	/* test if we have a DMA interrupt */
 	if (s0val != card->last_is0) {
@@ -1529,7 +1215,92 @@ nj_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 			write_tiger (card, s0val);
 		}
 	}
+}
+
+/*
+ * bottom half, the work units are the ISAC interrupt and the DMA pages.
+ * A new ISAC event retriggers the interrupt when the mask is cleared,
+ * so there is one ISAC unit at most. If the bottom half comes later
+ * than the next page flip, the position alone looks unchanged or one
+ * page ahead; the hardirq handler collects the free pages it saw in
+ * dma_pend, with both pages of a direction in there the older one is
+ * handled first.
+ */
+static int
+nj_bh_work(mISDN_irq_bh_t *bh, int budget)
+{
+	netjet_t	*card = bh->priv;
+	u_long		flags;
+	u_int8_t	s0val, pend;
+	int		cnt = 0;
+
+	spin_lock_irqsave(&card->lock, flags);
+	if (card->isac_pend) {
+		card->isac_pend = 0;
+		nj_isac_int(card);
+		cnt++;
+	}
+	s0val = nj_dma_page(card);
+	pend = card->dma_pend | s0val;
+	card->dma_pend = 0;
+	if ((pend & NETJET_IRQM0_READ_MASK) == NETJET_IRQM0_READ_MASK &&
+		((s0val ^ card->last_is0) & NETJET_IRQM0_READ_MASK) !=
+		NETJET_IRQM0_READ_MASK) {
+		read_tiger(card, s0val ^ NETJET_IRQM0_READ_MASK);
+		cnt++;
+	}
+	if ((pend & NETJET_IRQM0_WRITE_MASK) == NETJET_IRQM0_WRITE_MASK &&
+		((s0val ^ card->last_is0) & NETJET_IRQM0_WRITE_MASK) !=
+		NETJET_IRQM0_WRITE_MASK) {
+		write_tiger(card, s0val ^ NETJET_IRQM0_WRITE_MASK);
+		cnt++;
+	}
+	nj_dma_int(card);
+	cnt++;
+	spin_unlock_irqrestore(&card->lock, flags);
+	return(cnt);
+}
+
+static irqreturn_t
+nj_interrupt(int intno, void *dev_id, struct pt_regs *regs)
+{
+	netjet_t *card = dev_id;
+	u_int8_t s1val, s0val;
+
+	spin_lock(&card->lock);
+	mISDN_irq_bh_enter(&card->bh);
+
+	s0val = inb (card->base | NETJET_IRQSTAT0);
+	s1val = inb (card->base | NETJET_IRQSTAT1);
+	if ( ((s1val & NETJET_ISACIRQ) != 0) && (s0val == 0)) {
+		/* no interrupts for us */
+		/* shared IRQ */
+		spin_unlock(&card->lock);
+		return IRQ_NONE;
+	}
+
+	card->irqcnt++;
+
+	if (!(s1val & NETJET_ISACIRQ)) {
+		if (irq_bh) {
+			/* masked until the bottom half did read ISTA */
+			nj_writeISAC(card, ISAC_MASK, 0xFF);
+			card->isac_pend = 1;
+		} else
+			nj_isac_int(card);
+	}
+
+	if (s0val) {
+		/* write to clear */
+		outb (s0val, card->base | NETJET_IRQSTAT0);
+	}
 
+	if (irq_bh) {
+		card->dma_pend |= nj_dma_page(card);
+		mISDN_irq_bh_schedule(&card->bh);
+	} else
+		nj_dma_int(card);
+	mISDN_irq_bh_leave(&card->bh);
 	spin_unlock(&card->lock);
 
 	return IRQ_HANDLED;
@@ -1580,6 +1351,7 @@ nj_release_card(netjet_t *card)
 {
 	u_long		flags;
 
+	mISDN_irq_bh_kill(&card->bh);
 	nj_disable_hwirq(card);
 	spin_lock_irqsave(&card->lock, flags);
  	mode_tiger(&card->bch[0], 0, ISDN_PID_NONE);
@@ -1688,6 +1460,8 @@ setup_instance (netjet_t *card)
 		kfree(card);
 		return(err);
 	}
+	mISDN_irq_bh_init(&card->bh, card->dch.inst.name, nj_bh_work, card,
+		MISDN_BH_BUDGET);
 	netjet_cnt++;
 	err = mISDN_ctrl(NULL, MGR_NEWSTACK | REQUEST, &card->dch.inst);
 
@@ -34,25 +34,27 @@ void plciHandleSetupInd(Plci_t *plci, int pr, Q931_info_t *qi)
 	__u16			CIPValue;
 	Application_t		*appl;
 	AppPlci_t		*aplci;
-	struct list_head	*item, *next;
+	u_long			map[CAPI_APPL_BITMAP];
+	int			id;
 
 	if (!qi || !plci->contr) {
 		int_error();
 		return;
 	}
 	CIPValue = q931CIPValue(qi);
-	list_for_each_safe(item, next, &plci->contr->Applications) {
-		appl = (Application_t *)item;
-		if (test_bit(APPL_STATE_RELEASE, &appl->state))
+	/* only the listening applications are visited */
+	listenApplMap(plci->contr, CIPValue, map);
+	for (id = find_first_bit(map, CAPI_MAXAPPL + 1); id <= CAPI_MAXAPPL;
+		id = find_next_bit(map, CAPI_MAXAPPL + 1, id + 1)) {
+		appl = plci->contr->appltab[id];
+		if (!appl || test_bit(APPL_STATE_RELEASE, &appl->state))
 			continue;
-		if (listenHandle(appl, CIPValue)) {
-			aplci = ApplicationNewAppPlci(appl, plci);
-			if (!aplci) {
-				int_error();
-				break;
-			}
-			AppPlci_l3l4(aplci, pr, qi);
+		aplci = ApplicationNewAppPlci(appl, plci);
+		if (!aplci) {
+			int_error();
+			break;
 		}
+		AppPlci_l3l4(aplci, pr, qi);
 	}
 	if (plci->nAppl == 0) {
 		struct sk_buff *skb = mISDN_alloc_l3msg(10, MT_RELEASE_COMPLETE);
@@ -345,9 +345,32 @@ insertlayer(mISDNstack_t *st, mISDNlayer_t *layer, int layermask)
 }
 #endif
 
+#ifdef MISDN_LAT_STATS
+static inline void
+lat_count(u_int *hist, ktime_t delta)
+{
+	s64	ns = ktime_to_ns(delta);
+	u64	us;
+	int	i = 0;
+
+	if (ns > 0) {
+		us = ns;
+		do_div(us, 1000);
+		if (us >= (1 << (MISDN_LAT_BUCKETS - 2)))
+			i = MISDN_LAT_BUCKETS - 1;
+		else
+			i = fls((u_int)us);
+	}
+	hist[i]++;
+}
+#endif
+
 inline void
 _queue_message(mISDNstack_t *st, struct sk_buff *skb)
 {
+#ifdef MISDN_LAT_STATS
+	skb->tstamp = ktime_get();
+#endif
 	skb_queue_tail(&st->msgq, skb);
 	if (likely(!test_bit(mISDN_STACK_STOPPED, &st->status))) {
 		test_and_set_bit(mISDN_STACK_WORK, &st->status);
@@ -467,11 +490,67 @@ do_clear_stack(mISDNstack_t *st) {
 	release_layers(st, MGR_UNREGLAYER | REQUEST);
 }
 
+#define TEI_ROUTE_ALL	0	/* no kernel layer2 owns the TEI, copy to the clone */
+#define TEI_ROUTE_HERE	1	/* a layer2 of this stack owns the TEI */
+#define TEI_ROUTE_PASS	2	/* a layer2 on a later clone owns the TEI */
+
+/*
+ * TEI of a received D-channel frame against the TEIs the kernel layer2
+ * instances own (tei_owner, set in tei.c); group TEI frames and TEIs of
+ * a user space layer2 are not in there and go to every clone
+ */
+static int
+tei_route(mISDNstack_t *st, mISDNinstance_t *inst, struct sk_buff *skb)
+{
+	mISDNinstance_t	*cl;
+	int		tei;
+
+	/* EA bits of a LAPD address: 0 in the first, 1 in the second octet */
+	if (skb->len < 2 || (skb->data[0] & 1) || !(skb->data[1] & 1))
+		return(TEI_ROUTE_ALL);
+	tei = skb->data[1] >> 1;
+	if (test_bit(tei, st->tei_owner))
+		return(TEI_ROUTE_HERE);
+	for (cl = inst->clone; cl; cl = cl->clone)
+		if (cl->st && test_bit(tei, cl->st->tei_owner))
+			return(TEI_ROUTE_PASS);
+	return(TEI_ROUTE_ALL);
+}
+
+/*
+ * a clone gets every frame of a PH_DATA_CHAIN_IND as single PH_DATA_IND,
+ * only the instance which asked with HW_D_CHAIN_ON knows the chain
+ */
+static void
+clone_chain(mISDNstack_t *st, mISDNinstance_t *inst, u_int id, struct sk_buff *skb)
+{
+	struct sk_buff_head	fq;
+	struct sk_buff		*fskb;
+
+	skb_queue_head_init(&fq);
+	if (mISDN_copy_chain(skb, &fq) != mISDN_HEAD_DINFO(skb))
+		printk(KERN_WARNING "%s OOM on chain cloning inst(%08x) caddr(%08x)\n",
+			__FUNCTION__, inst->clone->id, id);
+	while ((fskb = __skb_dequeue(&fq))) {
+		if (tei_route(st, inst, fskb) == TEI_ROUTE_HERE) {
+			dev_kfree_skb(fskb);
+			continue;
+		}
+		mISDN_sethead(PH_DATA_IND, MISDN_ID_ANY, fskb);
+		if (mISDN_queue_message(inst->clone, id, fskb))
+			dev_kfree_skb(fskb);
+	}
+}
+
 static int
 mISDNStackd(void *data)
 {
 	mISDNstack_t	*st = data;
 	int		err = 0;
+#ifdef MISDN_LAT_STATS
+	ktime_t		t_start;
+	int		lc, mgr;
+#endif
 
 #ifdef CONFIG_SMP
 	mutex_lock(&misdn_stack_mutex);
@@ -481,12 +560,16 @@ mISDNStackd(void *data)
 #ifdef CONFIG_SMP
 	mutex_unlock(&misdn_stack_mutex);
 #endif
+	/* msgq is strict FIFO, only the master stacks may get a boost */
+	if (core_stack_nice && !(st->id & (FLG_CHILD_STACK | FLG_CLONE_STACK)))
+		set_user_nice(current, core_stack_nice);
 	if ( core_debug & DEBUG_THREADS)
 		printk(KERN_DEBUG "mISDNStackd started for id(%08x)\n", st->id);
 
 	for (;;) {
 		struct sk_buff	*skb, *c_skb;
 		mISDN_head_t	*hh;
+		int		route;
 		
 		if (unlikely(test_bit(mISDN_STACK_STOPPED, &st->status))) {
 			test_and_clear_bit(mISDN_STACK_WORK, &st->status);
@@ -542,8 +625,22 @@ mISDNStackd(void *data)
 #ifdef MISDN_MSG_STATS
 				st->clone_cnt++;
 #endif
-				c_skb = skb_copy(skb, GFP_KERNEL);
-				if (c_skb) {
+				if (hh->prim == PH_DATA_CHAIN_IND) {
+					clone_chain(st, inst, id, skb);
+					goto clone_done;
+				}
+				if (hh->prim == PH_DATA_IND) {
+					route = tei_route(st, inst, skb);
+					if (route == TEI_ROUTE_HERE)
+						goto clone_done;
+					/* not for us, hand it on without a copy */
+					if ((route == TEI_ROUTE_PASS) && (st->id & FLG_CLONE_STACK)) {
+						if (mISDN_queue_message(inst->clone, id, skb))
+							dev_kfree_skb(skb);
+						continue;
+					}
+				}
+				if ((c_skb = skb_copy(skb, GFP_KERNEL))) {
 					if (core_debug & DEBUG_MSG_THREAD_INFO)
 						printk(KERN_DEBUG "%s: inst(%08x) msg clone msg to(%08x) caddr(%08x) prim(%x)\n",
 							__FUNCTION__, inst->id, inst->clone->id, id, hh->prim);
@@ -559,6 +656,7 @@ mISDNStackd(void *data)
 						__FUNCTION__, inst->id, id, hh->prim, skb->len);
 				}
 			}
+clone_done:
 			if (core_debug & DEBUG_MSG_THREAD_INFO)
 				printk(KERN_DEBUG "%s: inst(%08x) msg call addr(%08x) prim(%x)\n",
 					__FUNCTION__, inst->id, hh->addr, hh->prim);
@@ -569,7 +667,19 @@ mISDNStackd(void *data)
 				dev_kfree_skb(skb);
 				continue;
 			}
+#ifdef MISDN_LAT_STATS
+			lc = CMD_IS_DATA(hh->prim) ? MISDN_LAT_DATA : MISDN_LAT_CTRL;
+			/* manager messages may release the instance */
+			mgr = ((hh->prim & LAYER_MASK) == MGR_FUNCTION);
+			t_start = ktime_get();
+			lat_count(inst->lat.queue[lc], ktime_sub(t_start, skb->tstamp));
+#endif
 			err = inst->function(inst, skb);
+#ifdef MISDN_LAT_STATS
+			if (!mgr)
+				lat_count(inst->lat.handler[lc],
+					ktime_sub(ktime_get(), t_start));
+#endif
 			if (err) {
 				if (core_debug & DEBUG_MSG_THREAD_ERR)
 					printk(KERN_DEBUG "%s: instance(%08x)->function return(%d)\n",
@@ -32,6 +32,16 @@ encodeInvokeComponentLength(__u8 *msg, __u8 *p)
 	msg[0] = p - &msg[1];
 }
 
+/*
+ * the facility is encoded in place behind the end of the message,
+ * so mISDN_AddIE() finds the content already there
+ */
+static __inline__ __u8 *
+facilityIEStart(struct sk_buff *skb)
+{
+	return(skb->data + skb->len + 1);
+}
+
 
 static int
 SSProcess_L4L3(SSProcess_t *spc, __u32 prim, struct sk_buff *skb) {
@@ -261,7 +271,7 @@ FacCFInterrogateParameters(Application_t *appl, FacReqParm_t *facReqParm, FacCon
 {
 	SSProcess_t	*sspc;
 	struct sk_buff	*skb = mISDN_alloc_l3msg(260, MT_FACILITY);
-	__u8		*p;
+	__u8		*msg, *p;
 
 	if (!skb)
 		return CAPI_MSGOSRESOURCEERR;
@@ -272,12 +282,13 @@ FacCFInterrogateParameters(Application_t *appl, FacReqParm_t *facReqParm, FacCon
 		return CAPI_MSGOSRESOURCEERR;
 	}
 
-	p = encodeInvokeComponentHead(sspc->buf);
+	msg = facilityIEStart(skb);
+	p = encodeInvokeComponentHead(msg);
 	p += encodeInt(p, sspc->invokeId);
 	p += encodeInt(p, 11); // interrogationDiversion
 	p += encodeInterrogationDiversion(p,  &facReqParm->u.CFInterrogateParameters);
-	encodeInvokeComponentLength(sspc->buf, p);
-	mISDN_AddIE(skb, IE_FACILITY, sspc->buf);
+	encodeInvokeComponentLength(msg, p);
+	mISDN_AddIE(skb, IE_FACILITY, msg);
 
 	SSProcess_L4L3(sspc, CC_FACILITY | REQUEST, skb);
 	SSProcessAddTimer(sspc, T_INTERROGATE);
@@ -291,7 +302,7 @@ FacCFInterrogateNumbers(Application_t *appl, FacReqParm_t *facReqParm, FacConfPa
 {
 	SSProcess_t	*sspc;
 	struct sk_buff	*skb = mISDN_alloc_l3msg(260, MT_FACILITY);
-	__u8		*p;
+	__u8		*msg, *p;
 
 	if (!skb)
 		return CAPI_MSGOSRESOURCEERR;
@@ -302,11 +313,12 @@ FacCFInterrogateNumbers(Application_t *appl, FacReqParm_t *facReqParm, FacConfPa
 		return CAPI_MSGOSRESOURCEERR;
 	}
 
-	p = encodeInvokeComponentHead(sspc->buf);
+	msg = facilityIEStart(skb);
+	p = encodeInvokeComponentHead(msg);
 	p += encodeInt(p, sspc->invokeId);
 	p += encodeInt(p, 17); // InterrogateServedUserNumbers
-	encodeInvokeComponentLength(sspc->buf, p);
-	mISDN_AddIE(skb, IE_FACILITY, sspc->buf);
+	encodeInvokeComponentLength(msg, p);
+	mISDN_AddIE(skb, IE_FACILITY, msg);
 	SSProcess_L4L3(sspc, CC_FACILITY | REQUEST, skb);
 	SSProcessAddTimer(sspc, T_INTERROGATE);
 
@@ -319,7 +331,7 @@ FacCFActivate(Application_t *appl, FacReqParm_t *facReqParm, FacConfParm_t *facC
 {
 	SSProcess_t	*sspc;
 	struct sk_buff	*skb = mISDN_alloc_l3msg(260, MT_FACILITY);
-	__u8		*p;
+	__u8		*msg, *p;
 
 	if (!skb)
 		return CAPI_MSGOSRESOURCEERR;
@@ -328,12 +340,13 @@ FacCFActivate(Application_t *appl, FacReqParm_t *facReqParm, FacConfParm_t *facC
 		kfree_skb(skb);
 		return CAPI_MSGOSRESOURCEERR;
 	}
-	p = encodeInvokeComponentHead(sspc->buf);
+	msg = facilityIEStart(skb);
+	p = encodeInvokeComponentHead(msg);
 	p += encodeInt(p, sspc->invokeId);
 	p += encodeInt(p, 7); // activationDiversion
 	p += encodeActivationDiversion(p, &facReqParm->u.CFActivate);
-	encodeInvokeComponentLength(sspc->buf, p);
-	mISDN_AddIE(skb, IE_FACILITY, sspc->buf);
+	encodeInvokeComponentLength(msg, p);
+	mISDN_AddIE(skb, IE_FACILITY, msg);
 	SSProcess_L4L3(sspc, CC_FACILITY | REQUEST, skb);
 	SSProcessAddTimer(sspc, T_ACTIVATE);
 
@@ -346,7 +359,7 @@ FacCFDeactivate(Application_t *appl, FacReqParm_t *facReqParm, FacConfParm_t *fa
 {
 	SSProcess_t	*sspc;
 	struct sk_buff	*skb = mISDN_alloc_l3msg(260, MT_FACILITY);
-	__u8		*p;
+	__u8		*msg, *p;
 
 	if (!skb)
 		return CAPI_MSGOSRESOURCEERR;
@@ -355,12 +368,13 @@ FacCFDeactivate(Application_t *appl, FacReqParm_t *facReqParm, FacConfParm_t *fa
 		kfree_skb(skb);
 		return CAPI_MSGOSRESOURCEERR;
 	}
-	p = encodeInvokeComponentHead(sspc->buf);
+	msg = facilityIEStart(skb);
+	p = encodeInvokeComponentHead(msg);
 	p += encodeInt(p, sspc->invokeId);
 	p += encodeInt(p, 8); // dectivationDiversion
 	p += encodeDeactivationDiversion(p, &facReqParm->u.CFDeactivate);
-	encodeInvokeComponentLength(sspc->buf, p);
-	mISDN_AddIE(skb, IE_FACILITY, sspc->buf);
+	encodeInvokeComponentLength(msg, p);
+	mISDN_AddIE(skb, IE_FACILITY, msg);
 
 	SSProcess_L4L3(sspc, CC_FACILITY | REQUEST, skb);
 	SSProcessAddTimer(sspc, T_DEACTIVATE);
@@ -374,7 +388,7 @@ FacCDeflection(AppPlci_t *aplci, FacReqParm_t *facReqParm, FacConfParm_t *facCon
 {
 	SSProcess_t	*sspc;
 	struct sk_buff	*skb = mISDN_alloc_l3msg(260, MT_FACILITY);
-	__u8		*p;
+	__u8		*msg, *p;
 
 	if (!skb)
 		return CAPI_MSGOSRESOURCEERR;
@@ -383,12 +397,13 @@ FacCDeflection(AppPlci_t *aplci, FacReqParm_t *facReqParm, FacConfParm_t *facCon
 		kfree_skb(skb);
 		return CAPI_MSGOSRESOURCEERR;
 	}
-	p = encodeInvokeComponentHead(sspc->buf);
+	msg = facilityIEStart(skb);
+	p = encodeInvokeComponentHead(msg);
 	p += encodeInt(p, sspc->invokeId);
 	p += encodeInt(p, 13); // Calldefection
 	p += encodeInvokeDeflection(p, &facReqParm->u.CDeflection);
-	encodeInvokeComponentLength(sspc->buf, p);
-	mISDN_AddIE(skb, IE_FACILITY, sspc->buf);
+	encodeInvokeComponentLength(msg, p);
+	mISDN_AddIE(skb, IE_FACILITY, msg);
 	if (aplci->plci)
 		plciL4L3(aplci->plci, CC_FACILITY | REQUEST, skb);
 	SSProcessAddTimer(sspc, T_ACTIVATE);
@@ -508,13 +523,23 @@ SSProcessConstr(Application_t *appl, __u16 Function, __u32 Handle)
 	return(sspc);
 }
 
-void SSProcessDestr(SSProcess_t *sspc)
+/* the caller holds the list_lock of the controller */
+void __SSProcessDestr(SSProcess_t *sspc)
 {
-	del_timer(&sspc->tl);
 	list_del_init(&sspc->head);
 	SSProcess_free(sspc);
 }
 
+void SSProcessDestr(SSProcess_t *sspc)
+{
+	Controller_t	*contr = sspc->contr;
+	u_long		flags;
+
+	spin_lock_irqsave(&contr->list_lock, flags);
+	__SSProcessDestr(sspc);
+	spin_unlock_irqrestore(&contr->list_lock, flags);
+}
+
 static void
 SendSSFacilityInd(Application_t *appl, __u32 addr, __u8 *para)
 {
@@ -577,10 +602,9 @@ SendSSFacilityInd2All(Controller_t *contr, __u32 nMask, __u8 *para)
 	}
 }
 
-void
-SSProcessTimeout(unsigned long arg)
+static void
+SSProcessExpired(SSProcess_t *sspc)
 {
-	SSProcess_t	*sspc = (SSProcess_t *) arg;
 	Application_t	*appl;
 	__u8		tmp[10], *p;
 
@@ -597,13 +621,60 @@ SSProcessTimeout(unsigned long arg)
 	SSProcessDestr(sspc);
 }
 
+/*
+ * One timer per controller serves all SSProcesses, it runs for the
+ * earliest expire time. The expired processes are collected under the
+ * list_lock and handled without it.
+ * A process is owned by the one who removes it from the SSProcesse list
+ * under the list_lock, the timer here or getSSProcess4Id() for a
+ * response, so only one of them sends the indication and destroys it.
+ */
+void
+SSProcessTimeout(unsigned long arg)
+{
+	Controller_t		*contr = (Controller_t *) arg;
+	struct list_head	*item, *next, expired;
+	SSProcess_t		*sspc;
+	u_long			flags, next_exp = 0;
+	int			pending = 0;
+
+	INIT_LIST_HEAD(&expired);
+	spin_lock_irqsave(&contr->list_lock, flags);
+	list_for_each_safe(item, next, &contr->SSProcesse) {
+		sspc = list_entry(item, SSProcess_t, head);
+		if (!sspc->expires)
+			continue;
+		if (time_after_eq(jiffies, sspc->expires)) {
+			sspc->expires = 0;
+			list_del(&sspc->head);
+			list_add_tail(&sspc->head, &expired);
+			continue;
+		}
+		if (!pending || time_before(sspc->expires, next_exp))
+			next_exp = sspc->expires;
+		pending = 1;
+	}
+	if (pending)
+		mod_timer(&contr->ss_timer, next_exp);
+	spin_unlock_irqrestore(&contr->list_lock, flags);
+	list_for_each_safe(item, next, &expired) {
+		SSProcessExpired(list_entry(item, SSProcess_t, head));
+	}
+}
+
 void SSProcessAddTimer(SSProcess_t *sspc, int msec)
 {
-	sspc->tl.function = SSProcessTimeout;
-	sspc->tl.data = (unsigned long) sspc;
-	init_timer(&sspc->tl);
-	sspc->tl.expires = jiffies + (msec * HZ) / 1000;
-	add_timer(&sspc->tl);
+	Controller_t	*contr = sspc->contr;
+	u_long		flags;
+
+	spin_lock_irqsave(&contr->list_lock, flags);
+	sspc->expires = jiffies + (msec * HZ) / 1000;
+	if (!sspc->expires) /* 0 means no timer */
+		sspc->expires = 1;
+	if (!timer_pending(&contr->ss_timer) ||
+		time_before(sspc->expires, contr->ss_timer.expires))
+		mod_timer(&contr->ss_timer, sspc->expires);
+	spin_unlock_irqrestore(&contr->list_lock, flags);
 }
 
 
@@ -692,8 +763,10 @@ SSProcessSingleFacility(Controller_t *contr, struct asn1_parm *parm)
 			if (!sspc)
 				return;
 			appl = getApplication4Id(contr, sspc->ApplId);
-			if (!appl)
+			if (!appl) {
+				SSProcessDestr(sspc);
 				return;
+			}
 			p = &tmp[1];
 			p += capiEncodeWord(p, sspc->Function);
 			switch (sspc->Function) {
@@ -724,8 +797,10 @@ SSProcessSingleFacility(Controller_t *contr, struct asn1_parm *parm)
 			if (!sspc)
 				return;
 			appl = getApplication4Id(contr, sspc->ApplId);
-			if (!appl)
+			if (!appl) {
+				SSProcessDestr(sspc);
 				return;
+			}
 			p = &tmp[1];
 			p += capiEncodeWord(p, sspc->Function);
 			p += capiEncodeFacIndCFact(p, 0x3600 | (parm->u.retError.errorValue & 0xff), 
@@ -753,8 +828,10 @@ SSProcessSingleFacility(Controller_t *contr, struct asn1_parm *parm)
 			if (!sspc)
 				return;
 			appl = getApplication4Id(contr, sspc->ApplId);
-			if (!appl)
+			if (!appl) {
+				SSProcessDestr(sspc);
 				return;
+			}
 			p = &tmp[1];
 			p += capiEncodeWord(p, sspc->Function);
 			p += capiEncodeFacIndCFact(p, 0x3700 | (parm->u.reject.problemValue & 0xff), 
@@ -0,0 +1,317 @@
+/*
+ * sw_hdlc.c: table driven software HDLC framing
+ *
+ * The encoder handles one data octet per table lookup, the table gives
+ * the bit stuffed output (8 - 10 bits) for every octet and count of
+ * leading 1 bits.
+ * The decoder looks up the remaining bits of a received octet together
+ * with the count of leading 1 bits and gets the number of plain data bits
+ * up to the next event (stuffed 0, flag, abort), so it needs only one
+ * lookup per event instead of one loop per bit.
+ * The FCS is calculated over complete buffers, 4 octets per step.
+ *
+ * This file is (c) under GNU PUBLIC LICENSE
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/ppp_defs.h>
+#include "sw_hdlc.h"
+
+#define HDLC_FLAG	0x7e
+
+/* encoder table entry: output bits | bitcount << 12 | ones << 16 */
+#define ENC_BITS(e)	((e) & 0x3ff)
+#define ENC_CNT(e)	(((e) >> 12) & 0xf)
+#define ENC_ONES(e)	((e) >> 16)
+
+/* decoder table entry: plain bits | event << 4 | ones << 8 */
+#define DEC_NONE	0
+#define DEC_STUFF	1
+#define DEC_FLAG	2
+#define DEC_ABORT	3
+
+#define DEC_CNT(e)	((e) & 0xf)
+#define DEC_EVENT(e)	(((e) >> 4) & 0x3)
+#define DEC_ONES(e)	((e) >> 8)
+
+static u_int	enc_tab[5][256];
+/* index is (1 << remaining bits) | remaining bits value */
+static u16	dec_tab[8][512];
+static u16	crc_tab[4][256];
+
+u16
+mISDN_hdlc_crc(u16 crc, const u_char *p, int len)
+{
+	while (len >= 4) {
+		crc ^= p[0] | (p[1] << 8);
+		crc = crc_tab[3][crc & 0xff] ^ crc_tab[2][crc >> 8] ^
+			crc_tab[1][p[2]] ^ crc_tab[0][p[3]];
+		p += 4;
+		len -= 4;
+	}
+	while (len--)
+		crc = (crc >> 8) ^ crc_tab[0][(crc ^ *p++) & 0xff];
+	return(crc);
+}
+
+static inline u_char *
+enc_put(hdlc_enc_t *enc, u_char *d, u_int bits, u_int cnt)
+{
+	enc->acc |= bits << enc->nacc;
+	enc->nacc += cnt;
+	if (enc->bits == HDLC_BITS_64K) {
+		while (enc->nacc >= 8) {
+			*d++ = enc->acc;
+			enc->acc >>= 8;
+			enc->nacc -= 8;
+		}
+	} else {
+		while (enc->nacc >= 7) {
+			*d++ = (enc->acc & 0x7f) | 0x80;
+			enc->acc >>= 7;
+			enc->nacc -= 7;
+		}
+	}
+	return(d);
+}
+
+void
+mISDN_hdlc_enc_init(hdlc_enc_t *enc, int bits)
+{
+	enc->acc = 0;
+	enc->nacc = 0;
+	enc->ones = 0;
+	enc->bits = bits;
+}
+
+/* all mISDN_hdlc_enc_* functions return the count of written octets */
+int
+mISDN_hdlc_enc_flag(hdlc_enc_t *enc, u_char *dst)
+{
+	enc->ones = 0;
+	return(enc_put(enc, dst, HDLC_FLAG, 8) - dst);
+}
+
+int
+mISDN_hdlc_enc_data(hdlc_enc_t *enc, u_char *dst, const u_char *src, int len)
+{
+	u_char	*d = dst;
+	u_int	e;
+
+	while (len--) {
+		e = enc_tab[enc->ones][*src++];
+		d = enc_put(enc, d, ENC_BITS(e), ENC_CNT(e));
+		enc->ones = ENC_ONES(e);
+	}
+	return(d - dst);
+}
+
+/* fill the last octet with 1 bits */
+int
+mISDN_hdlc_enc_flush(hdlc_enc_t *enc, u_char *dst)
+{
+	if (!enc->nacc)
+		return(0);
+	*dst = (enc->acc | (0xff << enc->nacc)) & 0xff;
+	enc->acc = 0;
+	enc->nacc = 0;
+	return(1);
+}
+
+/* flag, data, FCS and closing flag, the last octet is not flushed */
+int
+mISDN_hdlc_encode(hdlc_enc_t *enc, u_char *dst, const u_char *src, int len)
+{
+	u_char	*d = dst;
+	u_char	fcs[2];
+	u16	crc;
+
+	crc = mISDN_hdlc_crc(PPP_INITFCS, src, len) ^ 0xffff;
+	fcs[0] = crc & 0xff;
+	fcs[1] = crc >> 8;
+	d += mISDN_hdlc_enc_flag(enc, d);
+	d += mISDN_hdlc_enc_data(enc, d, src, len);
+	d += mISDN_hdlc_enc_data(enc, d, fcs, 2);
+	d += mISDN_hdlc_enc_flag(enc, d);
+	return(d - dst);
+}
+
+void
+mISDN_hdlc_dec_init(hdlc_dec_t *dec, int bits)
+{
+	memset(dec, 0, sizeof(hdlc_dec_t));
+	dec->state = HDLC_DEC_HUNT;
+	dec->bits = bits;
+}
+
+/*
+ * the 0 and the six 1 bits of a closing flag were already taken as
+ * data when the flag is detected, so 7 bits are removed again
+ */
+static int
+dec_frame_end(hdlc_dec_t *dec, u_char *dst)
+{
+	int	bits = dec->len * 8 + dec->nacc - 7;
+	int	ret = 0;
+
+	if (bits <= 0)
+		ret = 0;
+	else if (bits & 7)
+		ret = HDLC_DEC_ERR_ALIGN;
+	else if (bits < 3 * 8)
+		ret = HDLC_DEC_ERR_SHORT;
+	else if (mISDN_hdlc_crc(PPP_INITFCS, dst, bits >> 3) != PPP_GOODFCS)
+		ret = HDLC_DEC_ERR_CRC;
+	else
+		ret = (bits >> 3) - 2;
+	dec->acc = 0;
+	dec->nacc = 0;
+	dec->len = 0;
+	return(ret);
+}
+
+/*
+ * Decode received octets into dst (dsize bytes), stops after the octet
+ * which completed a frame.
+ * Returns the frame length without FCS, 0 if no frame was completed or
+ * a negative HDLC_DEC_ERR_* value for a dropped frame; *count is set to
+ * the number of processed octets.
+ */
+int
+mISDN_hdlc_decode(hdlc_dec_t *dec, const u_char *src, int slen, int *count,
+	u_char *dst, int dsize)
+{
+	const u_char	*s = src;
+	u_int		v, n, k, e;
+	int		ret = 0, fl;
+
+	while (s < src + slen) {
+		v = *s++;
+		n = dec->bits;
+		if (n == HDLC_BITS_56K)
+			v &= 0x7f;
+		while (n) {
+			e = dec_tab[dec->ones][(1 << n) | v];
+			k = DEC_CNT(e);
+			dec->ones = DEC_ONES(e);
+			if ((dec->state == HDLC_DEC_FRAME) && k) {
+				dec->acc |= (v & ((1 << k) - 1)) << dec->nacc;
+				dec->nacc += k;
+				if (dec->nacc >= 8) {
+					if (dec->len >= dsize) {
+						dec->state = HDLC_DEC_HUNT;
+						ret = HDLC_DEC_ERR_LONG;
+					} else {
+						dst[dec->len++] = dec->acc;
+						dec->acc >>= 8;
+						dec->nacc -= 8;
+					}
+				}
+			}
+			if (DEC_EVENT(e) == DEC_NONE)
+				break;
+			v >>= k + 1;
+			n -= k + 1;
+			switch (DEC_EVENT(e)) {
+			case DEC_FLAG:
+				if (dec->state == HDLC_DEC_FRAME) {
+					/* a flag ends a frame and starts the next */
+					if ((fl = dec_frame_end(dec, dst)))
+						ret = fl;
+				} else {
+					dec->state = HDLC_DEC_FRAME;
+					dec->acc = 0;
+					dec->nacc = 0;
+					dec->len = 0;
+				}
+				break;
+			case DEC_ABORT:
+				dec->state = HDLC_DEC_HUNT;
+				break;
+			default:	/* stuffed 0 is dropped */
+				break;
+			}
+		}
+		if (ret)
+			break;
+	}
+	*count = s - src;
+	return(ret);
+}
+
+void
+mISDN_hdlc_init(void)
+{
+	u_int	s, b, i, n, k, ones, bits, cnt, ev;
+	u16	crc;
+
+	for (b = 0; b < 256; b++) {
+		crc = b;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+		crc_tab[0][b] = crc;
+	}
+	for (b = 0; b < 256; b++)
+		for (i = 1; i < 4; i++)
+			crc_tab[i][b] = (crc_tab[i - 1][b] >> 8) ^
+				crc_tab[0][crc_tab[i - 1][b] & 0xff];
+
+	for (s = 0; s < 5; s++) {
+		for (b = 0; b < 256; b++) {
+			ones = s;
+			bits = 0;
+			cnt = 0;
+			for (i = 0; i < 8; i++) {
+				if (b & (1 << i)) {
+					bits |= 1 << cnt++;
+					if (++ones == 5) {
+						/* stuffed 0 */
+						cnt++;
+						ones = 0;
+					}
+				} else {
+					cnt++;
+					ones = 0;
+				}
+			}
+			enc_tab[s][b] = bits | (cnt << 12) | (ones << 16);
+		}
+	}
+
+	for (s = 0; s < 8; s++) {
+		for (n = 1; n <= 8; n++) {
+			for (b = 0; b < (1 << n); b++) {
+				ones = s;
+				ev = DEC_NONE;
+				for (k = 0; k < n; k++) {
+					if (b & (1 << k)) {
+						if (ones == 6)
+							ev = DEC_ABORT;
+						if (ones < 7)
+							ones++;
+					} else {
+						if (ones == 5)
+							ev = DEC_STUFF;
+						else if (ones == 6)
+							ev = DEC_FLAG;
+						ones = 0;
+					}
+					if (ev != DEC_NONE)
+						break;
+				}
+				dec_tab[s][(1 << n) | b] = k | (ev << 4) | (ones << 8);
+			}
+		}
+	}
+}
+
+EXPORT_SYMBOL(mISDN_hdlc_crc);
+EXPORT_SYMBOL(mISDN_hdlc_enc_init);
+EXPORT_SYMBOL(mISDN_hdlc_enc_flag);
+EXPORT_SYMBOL(mISDN_hdlc_enc_data);
+EXPORT_SYMBOL(mISDN_hdlc_enc_flush);
+EXPORT_SYMBOL(mISDN_hdlc_encode);
+EXPORT_SYMBOL(mISDN_hdlc_dec_init);
+EXPORT_SYMBOL(mISDN_hdlc_decode);
@@ -0,0 +1,61 @@
+/*
+ * sw_hdlc.h: table driven software HDLC framing for controllers which
+ * only provide a raw bitstream (e.g. Tiger 300/320)
+ *
+ * This file is (c) under GNU PUBLIC LICENSE
+ *
+ */
+
+#ifndef _MISDN_SW_HDLC_H
+#define _MISDN_SW_HDLC_H
+
+#include <linux/types.h>
+
+/*
+ * Bits are sent and received LSB first. In 56k mode only the lower 7 bits
+ * of a octet carry data, the MSB is always 1.
+ */
+#define HDLC_BITS_64K		8
+#define HDLC_BITS_56K		7
+
+typedef struct _hdlc_enc {
+	u_int	acc;		/* pending output bits, LSB first */
+	u_int	nacc;		/* count of pending bits */
+	u_int	ones;		/* consecutive 1 bits sent */
+	u_int	bits;		/* bits per octet on the line */
+} hdlc_enc_t;
+
+/* decoder states */
+#define HDLC_DEC_HUNT		0
+#define HDLC_DEC_FRAME		1
+
+/* decoder errors */
+#define HDLC_DEC_ERR_CRC	-1
+#define HDLC_DEC_ERR_ALIGN	-2
+#define HDLC_DEC_ERR_LONG	-3
+#define HDLC_DEC_ERR_SHORT	-4
+
+typedef struct _hdlc_dec {
+	u_int	acc;		/* received bits not yet stored */
+	u_int	nacc;
+	u_int	ones;		/* consecutive 1 bits received */
+	u_int	state;
+	u_int	len;		/* bytes stored in the frame buffer */
+	u_int	bits;		/* bits per octet on the line */
+} hdlc_dec_t;
+
+extern u16	mISDN_hdlc_crc(u16, const u_char *, int);
+
+extern void	mISDN_hdlc_enc_init(hdlc_enc_t *, int);
+extern int	mISDN_hdlc_enc_flag(hdlc_enc_t *, u_char *);
+extern int	mISDN_hdlc_enc_data(hdlc_enc_t *, u_char *, const u_char *, int);
+extern int	mISDN_hdlc_enc_flush(hdlc_enc_t *, u_char *);
+extern int	mISDN_hdlc_encode(hdlc_enc_t *, u_char *, const u_char *, int);
+
+extern void	mISDN_hdlc_dec_init(hdlc_dec_t *, int);
+extern int	mISDN_hdlc_decode(hdlc_dec_t *, const u_char *, int, int *,
+			u_char *, int);
+
+extern void	mISDN_hdlc_init(void);
+
+#endif
@@ -13,6 +13,34 @@
 
 #define to_mISDNinstance(d) container_of(d, mISDNinstance_t, class_dev)
 
+#ifdef MISDN_LAT_STATS
+static ssize_t
+show_lat(mISDNinstance_t *inst, char *buf)
+{
+	static char	*names[4] = {"queue ctrl", "queue data",
+				"handler ctrl", "handler data"};
+	u_int		*hist;
+	char		*p = buf;
+	int		i, j;
+
+	p += sprintf(p, "%-12s", "usec <");
+	for (j = 0; j < MISDN_LAT_BUCKETS - 1; j++)
+		p += sprintf(p, " %6d", 1 << j);
+	p += sprintf(p, " %6s\n", "more");
+	for (i = 0; i < 4; i++) {
+		if (i < 2)
+			hist = inst->lat.queue[i];
+		else
+			hist = inst->lat.handler[i - 2];
+		p += sprintf(p, "%-12s", names[i]);
+		for (j = 0; j < MISDN_LAT_BUCKETS; j++)
+			p += sprintf(p, " %6u", hist[j]);
+		p += sprintf(p, "\n");
+	}
+	return(p - buf);
+}
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
 static ssize_t show_inst_id(struct device *class_dev, struct device_attribute *attr, char *buf) {
         mISDNinstance_t *inst = to_mISDNinstance(class_dev);
@@ -40,6 +68,23 @@ static ssize_t show_inst_regcnt(struct device *class_dev, struct device_attribut
 }
 static DEVICE_ATTR(regcnt, S_IRUGO, show_inst_regcnt, NULL);
 
+#ifdef MISDN_LAT_STATS
+static ssize_t show_inst_latency(struct device *class_dev, struct device_attribute *attr, char *buf)
+{
+	return(show_lat(to_mISDNinstance(class_dev), buf));
+}
+static DEVICE_ATTR(latency, S_IRUGO, show_inst_latency, NULL);
+
+static ssize_t store_inst_latency_reset(struct device *class_dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	mISDNinstance_t *inst = to_mISDNinstance(class_dev);
+
+	memset(&inst->lat, 0, sizeof(mISDN_latstat_t));
+	return(count);
+}
+static DEVICE_ATTR(latency_reset, S_IWUSR, NULL, store_inst_latency_reset);
+#endif
+
 #else
 static ssize_t show_inst_id(struct class_device *class_dev, char *buf) {
 	mISDNinstance_t	*inst = to_mISDNinstance(class_dev);
@@ -66,6 +111,23 @@ static ssize_t show_inst_regcnt(struct class_device *class_dev, char *buf)
 	return sprintf(buf, "%d\n", inst->regcnt);
 }
 static CLASS_DEVICE_ATTR(regcnt, S_IRUGO, show_inst_regcnt, NULL);
+
+#ifdef MISDN_LAT_STATS
+static ssize_t show_inst_latency(struct class_device *class_dev, char *buf)
+{
+	return(show_lat(to_mISDNinstance(class_dev), buf));
+}
+static CLASS_DEVICE_ATTR(latency, S_IRUGO, show_inst_latency, NULL);
+
+static ssize_t store_inst_latency_reset(struct class_device *class_dev, const char *buf, size_t count)
+{
+	mISDNinstance_t	*inst = to_mISDNinstance(class_dev);
+
+	memset(&inst->lat, 0, sizeof(mISDN_latstat_t));
+	return(count);
+}
+static CLASS_DEVICE_ATTR(latency_reset, S_IWUSR, NULL, store_inst_latency_reset);
+#endif
 #endif
 
 #ifdef SYSFS_SUPPORT
@@ -142,11 +204,19 @@ mISDN_register_sysfs_inst(mISDNinstance_t *inst) {
         device_create_file(&inst->class_dev, &dev_attr_name);
         device_create_file(&inst->class_dev, &dev_attr_extentions);
         device_create_file(&inst->class_dev, &dev_attr_regcnt);
+#ifdef MISDN_LAT_STATS
+	device_create_file(&inst->class_dev, &dev_attr_latency);
+	device_create_file(&inst->class_dev, &dev_attr_latency_reset);
+#endif
 #else
 	class_device_create_file(&inst->class_dev, &class_device_attr_id);
 	class_device_create_file(&inst->class_dev, &class_device_attr_name);
 	class_device_create_file(&inst->class_dev, &class_device_attr_extentions);
 	class_device_create_file(&inst->class_dev, &class_device_attr_regcnt);
+#ifdef MISDN_LAT_STATS
+	class_device_create_file(&inst->class_dev, &class_device_attr_latency);
+	class_device_create_file(&inst->class_dev, &class_device_attr_latency_reset);
+#endif
 #endif
 
 #ifdef SYSFS_SUPPORT
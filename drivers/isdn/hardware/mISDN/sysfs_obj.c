@@ -10,6 +10,8 @@
 #include <linux/module.h>
 #include "core.h"
 #include "sysfs.h"
+#include "fsm.h"
+#include "irq_bh.h"
 
 #define to_mISDNobject(d) container_of(d, mISDNobject_t, class_dev)
 
@@ -123,6 +125,38 @@ static void release_mISDN_obj(struct class_device *dev)
 
 }
 
+#ifdef MISDN_FSM_STATS
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,34)
+static ssize_t show_fsm_stats(struct class *class, struct class_attribute *attr, char *buf)
+#else
+static ssize_t show_fsm_stats(struct class *class, char *buf)
+#endif
+{
+	return mISDN_FsmShowStats(buf, PAGE_SIZE);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,34)
+static ssize_t store_fsm_stats(struct class *class, struct class_attribute *attr, const char *buf, size_t count)
+#else
+static ssize_t store_fsm_stats(struct class *class, const char *buf, size_t count)
+#endif
+{
+	mISDN_FsmResetStats();
+	return count;
+}
+static CLASS_ATTR(fsm_stats, S_IRUGO | S_IWUSR, show_fsm_stats, store_fsm_stats);
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,34)
+static ssize_t show_irq_stats(struct class *class, struct class_attribute *attr, char *buf)
+#else
+static ssize_t show_irq_stats(struct class *class, char *buf)
+#endif
+{
+	return mISDN_irq_bh_show(buf, PAGE_SIZE);
+}
+static CLASS_ATTR(irq_stats, S_IRUGO, show_irq_stats, NULL);
+
 static struct class obj_dev_class = {
 	.name		= "mISDN-objects",
 #ifndef CLASS_WITHOUT_OWNER
@@ -193,6 +227,10 @@ mISDN_sysfs_init(void) {
 	err = class_register(&obj_dev_class);
 	if (err)
 		return(err);
+#ifdef MISDN_FSM_STATS
+	class_create_file(&obj_dev_class, &class_attr_fsm_stats);
+#endif
+	class_create_file(&obj_dev_class, &class_attr_irq_stats);
 	err = mISDN_sysfs_inst_init();
 	if (err)
 		goto unreg_obj;
@@ -209,6 +247,10 @@ unreg_obj:
 
 void
 mISDN_sysfs_cleanup(void) {
+#ifdef MISDN_FSM_STATS
+	class_remove_file(&obj_dev_class, &class_attr_fsm_stats);
+#endif
+	class_remove_file(&obj_dev_class, &class_attr_irq_stats);
 	class_unregister(&obj_dev_class);
 	mISDN_sysfs_inst_cleanup();
 	mISDN_sysfs_st_cleanup();
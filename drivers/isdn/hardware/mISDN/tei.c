@@ -77,23 +77,194 @@ random_ri(void)
 	return (x & 0xffff);
 }
 
+static LIST_HEAD(teitab_list);
+static DEFINE_SPINLOCK(teitab_lock);
+
+static void tei_t202_expire(unsigned long data);
+
 static teimgr_t *
 findtei(teimgr_t *tm, int tei)
 {
-	static teimgr_t *ptr = NULL;
-	struct sk_buff *skb;
+	layer2_t	*l2 = NULL;
+	u_long		flags;
 
-	if (tei == 127)
-		return (NULL);
-	skb = create_link_skb(MDL_FINDTEI | REQUEST, tei, sizeof(void), &ptr, 0);
-	if (!skb)
+	if (!tm->tt || tei < 0 || tei >= TEI_TABLE_SIZE)
 		return (NULL);
-	if (!tei_l2(tm->l2, skb))
-		return(ptr);
-	dev_kfree_skb(skb);
+	spin_lock_irqsave(&tm->tt->lock, flags);
+	l2 = tm->tt->l2[tei];
+	spin_unlock_irqrestore(&tm->tt->lock, flags);
+	return (l2 ? l2->tm : NULL);
+}
+
+void
+set_tei(layer2_t *l2, int tei)
+{
+	teitab_t	*tt = l2->tm ? l2->tm->tt : NULL;
+	u_long		flags;
+
+	if (!tt) {
+		l2->tei = tei;
+		return;
+	}
+	spin_lock_irqsave(&tt->lock, flags);
+	if (l2->tei >= 0 && l2->tei < TEI_TABLE_SIZE &&
+		tt->l2[l2->tei] == l2) {
+		tt->l2[l2->tei] = NULL;
+		clear_bit(l2->tei, l2->tm->st->tei_owner);
+	}
+	if (tei >= 0 && tei < TEI_TABLE_SIZE) {
+		if (!tt->l2[tei]) {
+			tt->l2[tei] = l2;
+			/* the stack thread routes frames for this TEI here */
+			set_bit(tei, l2->tm->st->tei_owner);
+		} else if (tt->l2[tei] != l2 && l2->debug)
+			printk(KERN_DEBUG "%s: tei %d already used by %s\n",
+				l2->inst.name, tei, tt->l2[tei]->inst.name);
+	}
+	l2->tei = tei;
+	spin_unlock_irqrestore(&tt->lock, flags);
+}
+
+/* the caller holds teitab_lock */
+static teitab_t *
+__find_teitab(void *key)
+{
+	teitab_t	*tt;
+
+	list_for_each_entry(tt, &teitab_list, list) {
+		if (tt->key == key) {
+			tt->refcnt++;
+			return (tt);
+		}
+	}
 	return (NULL);
 }
 
+static teitab_t *
+get_teitab(void *key)
+{
+	teitab_t	*tt, *ntt;
+	u_long		flags;
+
+	spin_lock_irqsave(&teitab_lock, flags);
+	tt = __find_teitab(key);
+	spin_unlock_irqrestore(&teitab_lock, flags);
+	if (tt)
+		return (tt);
+	if (!(ntt = kmalloc(sizeof(teitab_t), GFP_ATOMIC))) {
+		printk(KERN_ERR "kmalloc teitab failed\n");
+		return (NULL);
+	}
+	memset(ntt, 0, sizeof(teitab_t));
+	ntt->key = key;
+	ntt->refcnt = 1;
+	spin_lock_init(&ntt->lock);
+	spin_lock_init(&ntt->t202_lock);
+	INIT_LIST_HEAD(&ntt->t202_list);
+	init_timer(&ntt->t202);
+	ntt->t202.function = tei_t202_expire;
+	ntt->t202.data = (long) ntt;
+	spin_lock_irqsave(&teitab_lock, flags);
+	/* another stack may have added it meanwhile */
+	if (!(tt = __find_teitab(key))) {
+		list_add_tail(&ntt->list, &teitab_list);
+		tt = ntt;
+		ntt = NULL;
+	}
+	spin_unlock_irqrestore(&teitab_lock, flags);
+	if (ntt)
+		kfree(ntt);
+	return (tt);
+}
+
+static void
+put_teitab(teitab_t *tt)
+{
+	u_long		flags;
+
+	spin_lock_irqsave(&teitab_lock, flags);
+	if (--tt->refcnt) {
+		spin_unlock_irqrestore(&teitab_lock, flags);
+		return;
+	}
+	list_del(&tt->list);
+	spin_unlock_irqrestore(&teitab_lock, flags);
+	del_timer_sync(&tt->t202);
+	kfree(tt);
+}
+
+/*
+ * T202 of all TEI managers on one D-channel is served by a single timer,
+ * the pending managers are kept sorted by expiry time
+ */
+static void
+tei_add_t202(teimgr_t *tm)
+{
+	teitab_t	*tt = tm->tt;
+	teimgr_t	*p;
+	struct list_head *pos;
+	u_long		flags;
+
+	spin_lock_irqsave(&tt->lock, flags);
+	if (!list_empty(&tm->t202_list)) {
+		spin_unlock_irqrestore(&tt->lock, flags);
+		if (tm->debug)
+			tm->tei_m.printdebug(&tm->tei_m, "T202 already active");
+		return;
+	}
+	tm->t202_expires = jiffies + (tm->T202 * HZ) / 1000;
+	/* usually all managers use the same T202, so we stop at the tail */
+	for (pos = tt->t202_list.prev; pos != &tt->t202_list; pos = pos->prev) {
+		p = list_entry(pos, teimgr_t, t202_list);
+		if (!time_after(p->t202_expires, tm->t202_expires))
+			break;
+	}
+	list_add(&tm->t202_list, pos);
+	if (tt->t202_list.next == &tm->t202_list)
+		mod_timer(&tt->t202, tm->t202_expires);
+	spin_unlock_irqrestore(&tt->lock, flags);
+}
+
+static void
+tei_del_t202(teimgr_t *tm)
+{
+	u_long		flags;
+
+	spin_lock_irqsave(&tm->tt->lock, flags);
+	list_del_init(&tm->t202_list);
+	spin_unlock_irqrestore(&tm->tt->lock, flags);
+}
+
+static void
+tei_t202_expire(unsigned long data)
+{
+	teitab_t	*tt = (teitab_t *)data;
+	teimgr_t	*tm;
+	u_long		flags;
+
+	for (;;) {
+		/* release_tei() waits on t202_lock, so tm stays valid */
+		spin_lock_irqsave(&tt->t202_lock, flags);
+		spin_lock(&tt->lock);
+		if (list_empty(&tt->t202_list)) {
+			spin_unlock(&tt->lock);
+			spin_unlock_irqrestore(&tt->t202_lock, flags);
+			break;
+		}
+		tm = list_entry(tt->t202_list.next, teimgr_t, t202_list);
+		if (time_before(jiffies, tm->t202_expires)) {
+			mod_timer(&tt->t202, tm->t202_expires);
+			spin_unlock(&tt->lock);
+			spin_unlock_irqrestore(&tt->t202_lock, flags);
+			break;
+		}
+		list_del_init(&tm->t202_list);
+		spin_unlock(&tt->lock);
+		mISDN_FsmEvent(&tm->tei_m, EV_T202, NULL);
+		spin_unlock_irqrestore(&tt->t202_lock, flags);
+	}
+}
+
 static void
 put_tei_msg(teimgr_t *tm, u_char m_id, unsigned int ri, u_char tei)
 {
@@ -136,7 +307,7 @@ tei_id_request(struct FsmInst *fi, int event, void *arg)
 			"assign request ri %d", tm->ri);
 	put_tei_msg(tm, ID_REQUEST, tm->ri, 127);
 	mISDN_FsmChangeState(fi, ST_TEI_IDREQ);
-	mISDN_FsmAddTimer(&tm->t202, tm->T202, EV_T202, NULL, 1);
+	tei_add_t202(tm);
 	tm->N202 = 3;
 }
 
@@ -187,7 +358,7 @@ tei_id_assign(struct FsmInst *fi, int event, void *arg)
 				dev_kfree_skb(skb);
 		}
 	} else if (ri == tm->ri) {
-		mISDN_FsmDelTimer(&tm->t202, 1);
+		tei_del_t202(tm);
 		mISDN_FsmChangeState(fi, ST_TEI_NOP);
 		skb = create_link_skb(MDL_ASSIGN | REQUEST, tei, 0, NULL, 0);
 		if (!skb)
@@ -248,7 +419,7 @@ tei_id_chk_req(struct FsmInst *fi, int event, void *arg)
 	if (tm->debug)
 		tm->tei_m.printdebug(fi, "identity check req tei %d", tei);
 	if ((tm->l2->tei != -1) && ((tei == GROUP_TEI) || (tei == tm->l2->tei))) {
-		mISDN_FsmDelTimer(&tm->t202, 4);
+		tei_del_t202(tm);
 		mISDN_FsmChangeState(&tm->tei_m, ST_TEI_NOP);
 		put_tei_msg(tm, ID_CHK_RES, random_ri(), tm->l2->tei);
 	}
@@ -266,7 +437,7 @@ tei_id_remove(struct FsmInst *fi, int event, void *arg)
 	if (tm->debug)
 		tm->tei_m.printdebug(fi, "identity remove tei %d", tei);
 	if ((tm->l2->tei != -1) && ((tei == GROUP_TEI) || (tei == tm->l2->tei))) {
-		mISDN_FsmDelTimer(&tm->t202, 5);
+		tei_del_t202(tm);
 		mISDN_FsmChangeState(&tm->tei_m, ST_TEI_NOP);
 		skb = create_link_skb(MDL_REMOVE | REQUEST, 0, 0, NULL, 0);
 		if (!skb)
@@ -287,7 +458,7 @@ tei_id_verify(struct FsmInst *fi, int event, void *arg)
 			tm->l2->tei);
 	put_tei_msg(tm, ID_VERIFY, 0, tm->l2->tei);
 	mISDN_FsmChangeState(&tm->tei_m, ST_TEI_IDVERIFY);
-	mISDN_FsmAddTimer(&tm->t202, tm->T202, EV_T202, NULL, 2);
+	tei_add_t202(tm);
 	tm->N202 = 2;
 }
 
@@ -303,7 +474,7 @@ tei_id_req_tout(struct FsmInst *fi, int event, void *arg)
 			tm->tei_m.printdebug(fi, "assign req(%d) ri %d",
 				4 - tm->N202, tm->ri);
 		put_tei_msg(tm, ID_REQUEST, tm->ri, 127);
-		mISDN_FsmAddTimer(&tm->t202, tm->T202, EV_T202, NULL, 3);
+		tei_add_t202(tm);
 	} else {
 		tm->tei_m.printdebug(fi, "assign req failed");
 		skb = create_link_skb(MDL_ERROR | REQUEST, 0, 0, NULL, 0);
@@ -328,7 +499,7 @@ tei_id_ver_tout(struct FsmInst *fi, int event, void *arg)
 				"id verify req(%d) for tei %d",
 				3 - tm->N202, tm->l2->tei);
 		put_tei_msg(tm, ID_VERIFY, 0, tm->l2->tei);
-		mISDN_FsmAddTimer(&tm->t202, tm->T202, EV_T202, NULL, 4);
+		tei_add_t202(tm);
 	} else {
 		tm->tei_m.printdebug(fi, "verify req for tei %d failed",
 			tm->l2->tei);
@@ -469,12 +640,19 @@ static struct FsmNode TeiFnList[] =
 void
 release_tei(teimgr_t *tm)
 {
-	mISDN_FsmDelTimer(&tm->t202, 1);
+	u_long		flags;
+
+	/* a running T202 callback for tm is done once we get the lock */
+	spin_lock_irqsave(&tm->tt->t202_lock, flags);
+	tei_del_t202(tm);
+	spin_unlock_irqrestore(&tm->tt->t202_lock, flags);
+	set_tei(tm->l2, -1);
+	put_teitab(tm->tt);
 	kfree(tm);
 }
 
 int
-create_teimgr(layer2_t *l2) {
+create_teimgr(layer2_t *l2, mISDNstack_t *st) {
 	teimgr_t *ntei;
 
 	if (!l2) {
@@ -487,6 +665,7 @@ create_teimgr(layer2_t *l2) {
 	}
 	memset(ntei, 0, sizeof(teimgr_t));
 	ntei->l2 = l2;
+	ntei->st = st;
 	ntei->T202 = 2000;	/* T202  2000 milliseconds */
 	ntei->debug = l2->debug;
 	ntei->tei_m.debug = l2->debug;
@@ -499,8 +678,21 @@ create_teimgr(layer2_t *l2) {
 		ntei->tei_m.fsm = &teifsm;
 		ntei->tei_m.state = ST_TEI_NOP;
 	}
-	mISDN_FsmInitTimer(&ntei->tei_m, &ntei->t202);
+	INIT_LIST_HEAD(&ntei->t202_list);
+	/* clone stacks share the TEI table of their master */
+	while (st && st->master)
+		st = st->master;
+	if (!(ntei->tt = get_teitab(st))) {
+		kfree(ntei);
+		return(-ENOMEM);
+	}
 	l2->tm = ntei;
+	if (l2->tei != -1) {
+		int tei = l2->tei;
+
+		l2->tei = -1;
+		set_tei(l2, tei);
+	}
 	return(0);
 }
 
@@ -510,6 +702,7 @@ int TEIInit(void)
 	teifsm.event_count = TEI_EVENT_COUNT;
 	teifsm.strEvent = strTeiEvent;
 	teifsm.strState = strTeiState;
+	teifsm.name = "tei";
 	mISDN_FsmNew(&teifsm, TeiFnList, TEI_FN_COUNT);
 	return(0);
 }
@@ -33,6 +33,7 @@
 #include "helper.h"
 #include "debug.h"
 #include "w6692.h"
+#include "irq_bh.h"
 
 #include <mISDN/isdn_compat.h>
 
@@ -88,6 +89,8 @@ typedef struct _w6692pci {
 	w6692_bc		wbc[2];
 	channel_t		dch;
 	channel_t		bch[2];
+	mISDN_irq_bh_t		bh;
+	u_char			ista;	/* saved by hardirq for the bottom half */
 } w6692pci;
 
 #define W_LED1_ON	1
@@ -862,24 +865,13 @@ W6692B_interrupt(w6692pci *card, int ch)
 	}
 }
 
-static irqreturn_t
-w6692_interrupt(int intno, void *dev_id, struct pt_regs *regs)
-{
-	w6692pci	*card = dev_id;
-	u_char		ista;
+static int irq_bh;	/* use the common bottom half, module parameter */
 
-	spin_lock(&card->lock);
-	ista = ReadW6692(card, W_ISTA);
-	if ((ista | card->imask) == card->imask) {
-		/* possible a shared  IRQ reqest */
-		spin_unlock(&card->lock);
-		return IRQ_NONE;
-	}
-	card->irqcnt++;
-/* Begin IRQ handler */
+static void
+w6692_handle_ista(w6692pci *card, u_char ista)
+{
 	if (card->dch.debug & L1_DEB_ISAC)
 		mISDN_debugprint(&card->dch.inst, "ista %02x", ista);
-	ista &= ~card->imask;
 	if (ista & W_INT_B1_EXI)
 		W6692B_interrupt(card, 0);
 	if (ista & W_INT_B2_EXI)
@@ -894,7 +886,62 @@ w6692_interrupt(int intno, void *dev_id, struct pt_regs *regs)
 		handle_statusD(card);
 	if (ista & (W_INT_XINT0 | W_INT_XINT1)) /* XINT0/1 - never */
 		mISDN_debugprint(&card->dch.inst, "W6692 spurious XINT!");
-/* End IRQ Handler */
+}
+
+/*
+ * bottom half, one work unit is one ISTA value, the chip interrupts
+ * stay masked until all is done
+ */
+static int
+w6692_bh_work(mISDN_irq_bh_t *bh, int budget)
+{
+	w6692pci	*card = bh->priv;
+	u_char		ista;
+	u_long		flags;
+	int		cnt = 0;
+
+	spin_lock_irqsave(&card->lock, flags);
+	ista = card->ista;
+	card->ista = 0;
+	while (cnt < budget) {
+		if (!ista)
+			ista = ReadW6692(card, W_ISTA) & ~card->imask;
+		if (!ista)
+			break;
+		w6692_handle_ista(card, ista);
+		ista = 0;
+		cnt++;
+	}
+	if (cnt < budget)
+		enable_hwirq(card);
+	spin_unlock_irqrestore(&card->lock, flags);
+	return(cnt);
+}
+
+static irqreturn_t
+w6692_interrupt(int intno, void *dev_id, struct pt_regs *regs)
+{
+	w6692pci	*card = dev_id;
+	u_char		ista;
+
+	spin_lock(&card->lock);
+	mISDN_irq_bh_enter(&card->bh);
+	ista = ReadW6692(card, W_ISTA);
+	if ((ista | card->imask) == card->imask) {
+		/* possible a shared  IRQ reqest */
+		spin_unlock(&card->lock);
+		return IRQ_NONE;
+	}
+	card->irqcnt++;
+	ista &= ~card->imask;
+	if (irq_bh) {
+		/* mask all until the bottom half is done */
+		disable_hwirq(card);
+		card->ista |= ista;
+		mISDN_irq_bh_schedule(&card->bh);
+	} else
+		w6692_handle_ista(card, ista);
+	mISDN_irq_bh_leave(&card->bh);
 	spin_unlock(&card->lock);
 	return IRQ_HANDLED;
 }
@@ -1053,11 +1100,13 @@ MODULE_LICENSE("GPL");
 #endif
 #ifdef OLD_MODULE_PARAM
 MODULE_PARM(debug, "1i");
+MODULE_PARM(irq_bh, "1i");
 #define MODULE_PARM_T   "1-4i"
 MODULE_PARM(protocol, MODULE_PARM_T);
 MODULE_PARM(layermask, MODULE_PARM_T);
 #else
 module_param(debug, uint, S_IRUGO | S_IWUSR);
+module_param(irq_bh, uint, S_IRUGO);
 
 #ifdef OLD_MODULE_PARAM_ARRAY
 static int num_led=0, num_pots=0, num_protocol=0, num_layermask=0; 
@@ -1296,6 +1345,7 @@ release_card(w6692pci *card)
 {
 	u_long	flags;
 
+	mISDN_irq_bh_kill(&card->bh);
 	spin_lock_irqsave(&card->lock, flags);
 	disable_hwirq(card);
 	spin_unlock_irqrestore(&card->lock, flags);
@@ -1443,6 +1493,8 @@ static int setup_instance(w6692pci *card) {
 	card->dch.debug = debug;
 	spin_lock_init(&card->lock);
 	card->dch.inst.hwlock = &card->lock;
+	mISDN_irq_bh_init(&card->bh, card->dch.inst.name, w6692_bh_work, card,
+		MISDN_BH_BUDGET);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
 	card->dch.inst.class_dev.parent = &card->pdev->dev;
 #else
@@ -1478,6 +1530,7 @@ static int setup_instance(w6692pci *card) {
 		mISDN_freechannel(&card->dch);
 		mISDN_freechannel(&card->bch[1]);
 		mISDN_freechannel(&card->bch[0]);
+		mISDN_irq_bh_kill(&card->bh);
 		list_del(&card->list);
 		kfree(card);
 		return(err);
@@ -1358,16 +1358,19 @@ x25_dte_init(void)
 		dte_rfsm.event_count = R_EVENT_COUNT;
 		dte_rfsm.strEvent = X25strREvent;
 		dte_rfsm.strState = X25strRState;
+		dte_rfsm.name = "x25_r";
 		mISDN_FsmNew(&dte_rfsm, RFnList, R_FN_COUNT);
 		dte_pfsm.state_count = P_STATE_COUNT;
 		dte_pfsm.event_count = P_EVENT_COUNT;
 		dte_pfsm.strEvent = X25strPEvent;
 		dte_pfsm.strState = X25strPState;
+		dte_pfsm.name = "x25_p";
 		mISDN_FsmNew(&dte_pfsm, PFnList, P_FN_COUNT);
 		dte_dfsm.state_count = D_STATE_COUNT;
 		dte_dfsm.event_count = D_EVENT_COUNT;
 		dte_dfsm.strEvent = X25strDEvent;
 		dte_dfsm.strState = X25strDState;
+		dte_dfsm.name = "x25_d";
 		mISDN_FsmNew(&dte_dfsm, DFnList, D_FN_COUNT);
 		mISDN_module_register(THIS_MODULE);
 	}
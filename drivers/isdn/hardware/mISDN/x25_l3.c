@@ -1160,6 +1160,7 @@ X25_l3_init(void)
 	llfsm.event_count = LL_EVENT_COUNT;
 	llfsm.strEvent = strLLEvent;
 	llfsm.strState = strLLState;
+	llfsm.name = "x25_ll";
 	mISDN_FsmNew(&llfsm, LLFnList, LL_FN_COUNT);
 	return(0);
 }
@@ -229,6 +229,7 @@ l1_timer_expire_t3(xhfc_port_t * port)
 
 	clear_bit(HFC_L1_ACTIVATING, &port->l1_flags),
 	xhfc_ph_command(port, HFC_L1_FORCE_DEACTIVATE_TE);
+	stop_ch_chain(dch);
 
 	mISDN_queue_data(&dch->inst, FLG_MSG_UP,
 		(PH_DEACTIVATE | INDICATION),
@@ -276,6 +277,7 @@ l1_timer_expire_t4(xhfc_port_t * port)
 		printk(KERN_INFO "%s %s\n", __FUNCTION__, port->name);
 
 	clear_bit(HFC_L1_DEACTTIMER, &port->l1_flags);
+	stop_ch_chain(dch);
 	mISDN_queue_data(&dch->inst, FLG_MSG_UP,
 		(PH_DEACTIVATE | INDICATION), 0, 0, NULL, 0);
 	mISDN_queue_data(&dch->inst, dch->inst.id | MSG_BROADCAST,
@@ -393,6 +395,8 @@ su_new_state(xhfc_port_t * port)
 			0, NULL, 0);
 	}
 
+	if (prim == (PH_DEACTIVATE | INDICATION))
+		stop_ch_chain(dch);
 	mISDN_queue_data(&dch->inst, FLG_MSG_UP, prim, 0, 0, NULL, 0);
 }
 
@@ -446,12 +450,20 @@ handle_dmsg(channel_t *dch, struct sk_buff *skb)
 				// no deact request in TE mode !
 				ret = -EINVAL;
 			} else {
+				stop_ch_chain(dch);
 				xhfc_ph_command(port, HFC_L1_DEACTIVATE_NT);
 			}
 			break;
 
-		case (MDL_FINDTEI | REQUEST):
-			return(mISDN_queue_up(&dch->inst, 0, skb));
+		case (PH_CONTROL | REQUEST):
+			if (hh->dinfo == HW_D_CHAIN_ON) {
+				/* layer2 accepts PH_DATA_CHAIN_IND */
+				test_and_set_bit(FLG_RX_CHAIN, &dch->Flags);
+			} else if (hh->dinfo == HW_D_CHAIN_OFF) {
+				stop_ch_chain(dch);
+			} else
+				return(-EINVAL);
+			dev_kfree_skb(skb);
 			break;
 	}
 	
@@ -1004,7 +1016,7 @@ xhfc_read_fifo(xhfc_t * xhfc, __u8 channel)
 				ch->rx_skb = NULL;
 			}
 			
-			queue_ch_frame(ch, INDICATION, MISDN_ID_ANY, skb);
+			queue_ch_dframe(ch, skb);
 
 		      read_exit:
 			if (ch->rx_skb)
@@ -1081,6 +1093,7 @@ xhfc_bh_handler(unsigned long ul_hw)
 
 				xhfc->fifo_irq &= ~(1 << (i * 2 + 1));
 				xhfc_read_fifo(xhfc, i);
+				flush_ch_frames(&xhfc->chan[i].ch);
 			}
 		}
 	}
@@ -1647,6 +1660,7 @@ init_mISDN_channels(xhfc_t * xhfc)
 #endif
 		mISDN_init_instance(&ch->inst, &hw_mISDNObj, xhfc, xhfc_l2l1);
 		ch->inst.pid.layermask = ISDN_LAYER(0);
+		ch->inst.extentions |= EXT_INST_DCHAIN;
 		sprintf(ch->inst.name, "%s_%d_D", xhfc->name, pt);
 		err = mISDN_initchannel(ch, MSK_INIT_DCHANNEL, MAX_DFRAME_LEN_L1);
 		if (err)
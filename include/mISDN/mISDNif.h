@@ -166,6 +166,8 @@
 #define HW_FIRM_END	0xFF12
 #define HW_D_BLOCKED	0xFF20
 #define HW_D_NOBLOCKED	0xFF21
+#define HW_D_CHAIN_ON	0xFF22
+#define HW_D_CHAIN_OFF	0xFF23
 #define HW_TESTRX_RAW	0xFF40
 #define HW_TESTRX_HDLC	0xFF41
 #define HW_TESTRX_OFF	0xFF4f
@@ -237,6 +239,7 @@
 #define PH_ACTIVATE	0x010100
 #define PH_DEACTIVATE	0x010000
 #define PH_DATA		0x110200
+#define PH_DATA_CHAIN	0x110300
 #define MPH_DEACTIVATE	0x011000
 #define MPH_ACTIVATE	0x011100
 #define MPH_INFORMATION	0x012000
@@ -307,6 +310,13 @@
 #define PH_DATA_IND		(PH_DATA | INDICATION)
 #define PH_DATA_CNF		(PH_DATA | CONFIRM)
 #define PH_DATA_RSP		(PH_DATA | RESPONSE)
+/*
+ * PH_DATA_CHAIN_IND carries dinfo frames in one message, the first frame
+ * is the linear part of the skb, the others are linked on its frag_list;
+ * only instances with EXT_INST_DCHAIN send it and only after a
+ * HW_D_CHAIN_ON request, clones get single PH_DATA_IND messages
+ */
+#define PH_DATA_CHAIN_IND	(PH_DATA_CHAIN | INDICATION)
 #define MPH_ACTIVATE_REQ	(MPH_ACTIVATE | REQUEST)
 #define MPH_DEACTIVATE_REQ	(MPH_DEACTIVATE | REQUEST)
 #define MPH_INFORMATION_IND	(MPH_INFORMATION | INDICATION)
@@ -537,6 +547,7 @@
 #define EXT_INST_MGR	0x00000200
 #define EXT_INST_MIDDLE	0x00000400
 #define EXT_INST_UNUSED 0x00000800
+#define EXT_INST_DCHAIN	0x00001000
 //#define EXT_IF_CHAIN	0x00010000
 //#define EXT_IF_EXCLUSIV	0x00020000
 //#define EXT_IF_CREATE	0x00040000
@@ -750,6 +761,11 @@ typedef struct _Q931_info {
 #include <linux/list.h>
 #include <linux/skbuff.h>
 
+/* latency statistics need the ktime based skb timestamp */
+#if defined(MISDN_LAT_STATS) && (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,22))
+#undef MISDN_LAT_STATS
+#endif
+
 typedef struct _mISDNobject	mISDNobject_t;
 typedef struct _mISDNinstance	mISDNinstance_t;
 typedef struct _mISDNstack	mISDNstack_t;
@@ -811,6 +827,21 @@ struct _mISDNif {
 #endif
 
 /* a instance of a mISDNobject */
+#ifdef MISDN_LAT_STATS
+/*
+ * log2 histograms in usec, bucket 0 is < 1 usec, bucket n counts
+ * 2^(n-1) <= t < 2^n usec, the last bucket takes all longer times
+ */
+#define MISDN_LAT_BUCKETS	16
+#define MISDN_LAT_CTRL		0
+#define MISDN_LAT_DATA		1
+
+typedef struct _mISDN_latstat {
+	u_int	queue[2][MISDN_LAT_BUCKETS];	/* enqueue -> dequeue */
+	u_int	handler[2][MISDN_LAT_BUCKETS];	/* inst->function */
+} mISDN_latstat_t;
+#endif
+
 struct _mISDNinstance {
 	struct list_head	list;
 	char			name[mISDN_MAX_IDLEN];
@@ -825,6 +856,9 @@ struct _mISDNinstance {
 	mISDNinstance_t		*parent;
 	if_func_t		*function;
 	spinlock_t		*hwlock;
+#ifdef MISDN_LAT_STATS
+	mISDN_latstat_t		lat;
+#endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
         struct device           class_dev;
 #else
@@ -868,6 +902,8 @@ struct _mISDNstack {
 	mISDNstack_t		*clone;
 	mISDNstack_t		*parent;
 	struct list_head	childlist;
+	/* TEIs assigned to a kernel layer2 of this stack */
+	u_long			tei_owner[128 / BITS_PER_LONG];
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
         struct device           class_dev;
 #else